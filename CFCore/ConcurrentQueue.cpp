@@ -11,13 +11,16 @@ DeQueueBlocking(Core::Thread *inCurThread, SInt32 inTimeoutInMilSecs) {
   Core::MutexLocker theLocker(&fMutex);
   /* 如果 fQueue.GetLength() == 0,则调用 fCond.Wait 即调用 pthread_cond_timedwait
    * 等待条件变量有效 */
+  /* 在锁内检查 stop 请求，与 Wakeup 配合，不会错过停止时的唤醒 */
+  bool willWait = fQueue.GetLength() == 0 &&
+      (inCurThread == nullptr || !inCurThread->IsStopRequested());
 #ifdef __Win32_
-  if (fQueue.GetLength() == 0) {
+  if (willWait) {
       fCond.Wait(&fMutex, inTimeoutInMilSecs);
       return nullptr;
   }
 #else
-  if (fQueue.GetLength() == 0)
+  if (willWait)
     fCond.Wait(&fMutex, inTimeoutInMilSecs);
 #endif
 
@@ -46,3 +49,7 @@ void BlockingQueue::EnQueue(QueueElem *obj) {
   fCond.Signal();
 }
 
+void BlockingQueue::Wakeup() {
+  Core::MutexLocker theLocker(&fMutex);
+  fCond.Broadcast();
+}
@@ -54,6 +54,7 @@ class BufferPool {
   // ACCESSORS
   UInt32 GetTotalNumBuffers() { return fTotNumBuffers; }
   UInt32 GetNumAvailableBuffers() { return fQueue.GetLength(); }
+  UInt32 GetBufferSize() { return fBufSize; }
 
   //
   // All these functions are Thread-safe
@@ -48,6 +48,9 @@ class BlockingQueue {
   QueueElem *DeQueue(); //will not block
   void EnQueue(QueueElem *obj);
 
+  // wake waiters in DeQueueBlocking, e.g. after a stop request
+  void Wakeup();
+
   Core::Cond *GetCond() { return &fCond; }
 
   Queue *GetQueue() { return &fQueue; }
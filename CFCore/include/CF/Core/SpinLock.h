@@ -7,17 +7,37 @@
 
 #include <atomic>
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 namespace CF {
 namespace Core {
 
+/**
+ * @brief 自旋等待时让出流水线，避免抢占同核的超线程
+ */
+inline void CpuRelax() {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
 class SpinLock {
  public:
   SpinLock() = default;
   ~SpinLock() = default;
 
   void Lock() {
-    bool unlatched = false;
-    while(!_lock.compare_exchange_weak(unlatched, true, std::memory_order_acquire));
+    while (true) {
+      bool unlatched = false;
+      if (_lock.compare_exchange_weak(unlatched, true, std::memory_order_acquire))
+        return;
+      // wait on a plain load, so the cache line is not bounced by the CAS
+      while (_lock.load(std::memory_order_relaxed)) CpuRelax();
+    }
   }
 
   void Unlock() {
@@ -25,7 +45,7 @@ class SpinLock {
   }
 
  private:
-  std::atomic_bool _lock;
+  std::atomic_bool _lock{false};
 };
 
 class SpinLocker {
@@ -6,12 +6,15 @@
 #include <CF/StringFormatter.h>
 #include <CF/Queue.h>
 #include <CF/CFState.h>
+#include <CF/Core/Time.h>
 
 using namespace CF;
 
 // STATIC DATA
 
 SInt32 CFEnv::sExitCode = 0;
+Core::Mutex CFEnv::sExitMutex;
+Core::Cond CFEnv::sExitCond;
 
 CFConfigure *CFEnv::sConfigure = nullptr;
 
@@ -62,6 +65,23 @@ void CFEnv::Initialize() {
   makeServerHeader();
 }
 
+void CFEnv::Exit(UInt32 exitCode) {
+  Core::MutexLocker locker(&sExitMutex);
+  sExitCode = exitCode;
+  sExitCond.Broadcast();
+}
+
+bool CFEnv::WaitForExit(SInt32 inTimeoutMilli) {
+  Core::MutexLocker locker(&sExitMutex);
+  SInt64 theDeadline = Core::Time::Milliseconds() + inTimeoutMilli;
+  while (sExitCode == 0) {
+    SInt64 theTimeout = theDeadline - Core::Time::Milliseconds();
+    if (theTimeout <= 0) break;
+    sExitCond.Wait(&sExitMutex, (SInt32) theTimeout);
+  }
+  return sExitCode != 0;
+}
+
 bool CFEnv::AddListenerSocket(Net::TCPListenerSocket *socket) {
   CFState::sListenerSocket.EnQueue(new QueueElem(socket));
   return true;
@@ -0,0 +1,188 @@
+#include <string.h>
+#include <CF/Net/Http/HTTPChunkedDecoder.h>
+
+using namespace CF::Net;
+
+static SInt32 hexValue(char inChar) {
+  if (inChar >= '0' && inChar <= '9') return inChar - '0';
+  if (inChar >= 'a' && inChar <= 'f') return inChar - 'a' + 10;
+  if (inChar >= 'A' && inChar <= 'F') return inChar - 'A' + 10;
+  return -1;
+}
+
+void HTTPChunkedDecoder::Reset() {
+  fState = kSize;
+  fSizeDigits = 0;
+  fSize = 0;
+  fRemaining = 0;
+  fDecodedLength = 0;
+}
+
+CF_Error HTTPChunkedDecoder::Decode(char *ioData, UInt32 inLength,
+                                    UInt32 *outConsumed, UInt32 *outDecoded) {
+  UInt32 thePos = 0;
+  UInt32 theDecoded = 0;
+
+  while (thePos < inLength && fState != kDone && fState != kError) {
+    char theChar = ioData[thePos];
+
+    switch (fState) {
+      case kSize: {
+        SInt32 theValue = hexValue(theChar);
+        if (theValue >= 0) {
+          fSize = (fSize << 4) | (UInt32) theValue;
+          fSizeDigits++;
+          if (fSize > kMaxChunkSize) fState = kError;
+        } else if (fSizeDigits == 0) {
+          fState = kError;
+        } else if (theChar == '\r') {
+          fState = kSizeLF;
+        } else if (theChar == '\n') {
+          fState = fSize > 0 ? kData : kTrailer;
+          fRemaining = fSize;
+        } else if (theChar == ';' || theChar == ' ' || theChar == '\t') {
+          fState = kExtension;
+        } else {
+          fState = kError;
+        }
+        thePos++;
+        break;
+      }
+
+      case kExtension: {
+        auto *theEOL = (char *) ::memchr(ioData + thePos, '\n', inLength - thePos);
+        if (theEOL == nullptr) {
+          thePos = inLength;
+          break;
+        }
+        thePos = (UInt32) (theEOL - ioData) + 1;
+        fState = fSize > 0 ? kData : kTrailer;
+        fRemaining = fSize;
+        break;
+      }
+
+      case kSizeLF: {
+        if (theChar != '\n') {
+          fState = kError;
+          break;
+        }
+        thePos++;
+        fState = fSize > 0 ? kData : kTrailer;
+        fRemaining = fSize;
+        break;
+      }
+
+      case kData: {
+        UInt32 theLen = inLength - thePos;
+        if (theLen > fRemaining)
+          theLen = (UInt32) fRemaining;
+        if (theDecoded != thePos)
+          ::memmove(ioData + theDecoded, ioData + thePos, theLen);
+        theDecoded += theLen;
+        thePos += theLen;
+        fRemaining -= theLen;
+        if (fRemaining == 0)
+          fState = kDataCR;
+        break;
+      }
+
+      case kDataCR: {
+        if (theChar == '\r') {
+          fState = kDataLF;
+        } else if (theChar == '\n') {
+          fState = kSize;
+        } else {
+          fState = kError;
+          break;
+        }
+        thePos++;
+        if (fState == kSize) {
+          fSize = 0;
+          fSizeDigits = 0;
+        }
+        break;
+      }
+
+      case kDataLF: {
+        if (theChar != '\n') {
+          fState = kError;
+          break;
+        }
+        thePos++;
+        fState = kSize;
+        fSize = 0;
+        fSizeDigits = 0;
+        break;
+      }
+
+      case kTrailer: {
+        thePos++;
+        if (theChar == '\r')
+          fState = kEndLF;
+        else if (theChar == '\n')
+          fState = kDone;
+        else
+          fState = kTrailerLine;
+        break;
+      }
+
+      case kTrailerLine: {
+        // trailer fields are not passed on
+        auto *theEOL = (char *) ::memchr(ioData + thePos, '\n', inLength - thePos);
+        if (theEOL == nullptr) {
+          thePos = inLength;
+          break;
+        }
+        thePos = (UInt32) (theEOL - ioData) + 1;
+        fState = kTrailer;
+        break;
+      }
+
+      case kEndLF: {
+        if (theChar != '\n') {
+          fState = kError;
+          break;
+        }
+        thePos++;
+        fState = kDone;
+        break;
+      }
+
+      default: break;
+    }
+  }
+
+  fDecodedLength += theDecoded;
+  if (outConsumed != nullptr)
+    *outConsumed = thePos;
+  if (outDecoded != nullptr)
+    *outDecoded = theDecoded;
+
+  return fState == kError ? CF_BadArgument : CF_NoErr;
+}
+
+UInt32 HTTPChunkedDecoder::GetMinRemaining() {
+  // line ends may be a bare '\n', the shortest last chunk is "0\n\n"
+  UInt64 theMin;
+  switch (fState) {
+    case kSize:
+      if (fSizeDigits == 0) {
+        theMin = 3;
+        break;
+      }
+      // the size can only grow
+      // fall through
+    case kExtension:
+    case kSizeLF:
+      theMin = fSize == 0 ? 2 : 1 + fSize + 1 + 3;
+      break;
+    case kData: theMin = fRemaining + 1 + 3; break;
+    case kDataCR:
+    case kDataLF: theMin = 1 + 3; break;
+    case kTrailer:
+    case kEndLF: theMin = 1; break;
+    case kTrailerLine: theMin = 2; break;
+    default: theMin = 0; break;
+  }
+  return theMin > 0xFFFFFFFF ? 0xFFFFFFFF : (UInt32) theMin;
+}
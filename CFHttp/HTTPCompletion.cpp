@@ -0,0 +1,57 @@
+#include <CF/Net/Http/HTTPCompletion.h>
+
+using namespace CF::Net;
+
+HTTPCompletion::HTTPCompletion(Thread::Task *inTask, UInt32 inTimeoutInMsec)
+    : fMutex(),
+      fTask(inTask),
+      fRequest(nullptr),
+      fResponse(nullptr),
+      fTimeoutInMsec(inTimeoutInMsec),
+      fResult(CF_NoErr),
+      fCompleted(false),
+      fRefCount(2) {
+}
+
+HTTPCompletion::~HTTPCompletion() {
+  delete fRequest;
+  delete fResponse;
+}
+
+void HTTPCompletion::Complete(CF_Error inErr) {
+  {
+    Core::MutexLocker locker(&fMutex);
+    Assert(!fCompleted);
+    fResult = inErr;
+    fCompleted = true;
+
+    // the session waits for this even after it detached, it can't go away
+    // before the lock is released
+    fTask->Signal(Thread::Task::kUpdateEvent);
+  }
+
+  this->Release();
+}
+
+bool HTTPCompletion::IsCompleted(CF_Error *outErr) {
+  Core::MutexLocker locker(&fMutex);
+  if (fCompleted && outErr != nullptr)
+    *outErr = fResult;
+  return fCompleted;
+}
+
+bool HTTPCompletion::Detach(HTTPPacket *inRequest, HTTPPacket *inResponse) {
+  Core::MutexLocker locker(&fMutex);
+  if (fCompleted)
+    return false;
+
+  Assert(fRequest == nullptr && fResponse == nullptr);
+  fRequest = inRequest;
+  fResponse = inResponse;
+  return true;
+}
+
+void HTTPCompletion::Release() {
+  if (--fRefCount == 0)
+    delete this;
+}
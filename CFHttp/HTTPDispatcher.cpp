@@ -11,15 +11,12 @@ StrPtrLen HTTPPathMapper::sAllSuffix("/*", 2);
 StrPtrLen HTTPPathMapper::sTypePrefix("*.", 2);
 StrPtrLen HTTPPathMapper::sRootPath("/", 1);
 
-int cmp_mapper(const void *a, const void *b) {
-  return HTTPPathMapper::ComparePriority(*(HTTPPathMapper **) a,
-                                         *(HTTPPathMapper **) b);
-}
-
 HTTPDispatcher::HTTPDispatcher(HTTPMapping *mapping) {
   int count;
   for (count = 0; true; count++) {
-    if (mapping[count].path == nullptr || mapping[count].func == nullptr) break;
+    if (mapping[count].path == nullptr
+        || (mapping[count].func == nullptr && mapping[count].async == nullptr))
+      break;
   }
 
   fMappers = new HTTPPathMapper *[count];
@@ -28,28 +25,34 @@ HTTPDispatcher::HTTPDispatcher(HTTPMapping *mapping) {
   UInt32 index = 0;
   for (int i = 0; i < count; i++) {
     HTTPPathMapper *mapper = HTTPPathMapper::BuildPathMatcher(mapping[i]);
-    if (mapper != nullptr)
-      fMappers[index++] = mapper;
-    else
+    if (mapper == nullptr) {
       s_printf("error: construct path matcher failed, path: %s",
-               mapping->path);
+               mapping[i].path);
+    } else if (!fRouter.Add(mapping[i].path, mapper)) {
+      s_printf("error: bad or duplicate route, path: %s", mapping[i].path);
+      delete mapper;
+    } else {
+      fMappers[index++] = mapper;
+    }
   }
   fMapperNum = index;
-
-  // sort
-  qsort(fMappers, fMapperNum, sizeof(HTTPPathMapper *), cmp_mapper);
 }
 
 CF_Error HTTPDispatcher::Dispatch(HTTPPacket &request, HTTPPacket &response) {
+  HTTPPathMapper *mapper = this->Match(request);
+  if (mapper == nullptr)
+    return CF_FileNotFound;
 
-  StrPtrLen *requestPath = request.GetRequestRelativeURI();
+  // async CGIs are run by the session, see HTTPSession
+  if (mapper->IsAsync())
+    return CF_Unimplemented;
 
-  for (UInt32 i = 0; i < fMapperNum; i++) {
-    if (fMappers[i]->Match(*requestPath))
-      return fMappers[i]->Mapping(request, response);
-  }
+  return mapper->Mapping(request, response);
+}
 
-  return CF_FileNotFound;
+HTTPPathMapper *HTTPDispatcher::Match(HTTPPacket &request) {
+  return fRouter.Match(*request.GetRequestRelativeURI(),
+                       request.GetPathParams());
 }
 
 HTTPPathMapper *HTTPPathMapper::BuildPathMatcher(HTTPMapping &mapping) {
@@ -75,10 +78,5 @@ HTTPPathMapper *HTTPPathMapper::BuildPathMatcher(HTTPMapping &mapping) {
   return new ExactPathMapper(mapping);
 }
 
-int HTTPPathMapper::ComparePriority(HTTPPathMapper *aMapper,
-                                    HTTPPathMapper *bMapper) {
-  return aMapper->ItsType() - bMapper->ItsType();
-}
-
 } // namespace Net
 } // namespace CF
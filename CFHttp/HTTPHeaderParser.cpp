@@ -0,0 +1,162 @@
+#include <string.h>
+#include <CF/Net/Http/HTTPHeaderParser.h>
+
+using namespace CF::Net;
+
+// The first '\r' or '\n' in [inPos, inEnd), nullptr if there is none.
+// memchr is vectorized by the C library, a line is looked at once or twice.
+static char const *findEOL(char const *inPos, char const *inEnd) {
+  auto *theLF = (char const *) ::memchr(inPos, '\n', inEnd - inPos);
+  char const *theLimit = theLF != nullptr ? theLF : inEnd;
+  auto *theCR = (char const *) ::memchr(inPos, '\r', theLimit - inPos);
+  return theCR != nullptr ? theCR : theLF;
+}
+
+static bool isBlank(char inChar) { return inChar == ' ' || inChar == '\t'; }
+
+void HTTPHeaderParser::Reset() {
+  fState = kLeadingEOL;
+  fLineState = kLeadingEOL;
+  fOffset = 0;
+  fLineStart = 0;
+  fLineEnd = 0;
+  fLoneCR = false;
+  fMalformed = false;
+  fStartLineOffset = 0;
+  fStartLineLen = 0;
+  fFieldsOffset = 0;
+  fNumFields = 0;
+}
+
+void HTTPHeaderParser::Release() {
+  this->Reset();
+  delete[] fFields;
+  fFields = nullptr;
+  fFieldsSize = 0;
+}
+
+bool HTTPHeaderParser::Parse(char const *inData, UInt32 inLength) {
+  if (inLength < fOffset)
+    this->Reset();
+
+  char const *theEnd = inData + inLength;
+  while (fState != kDone) {
+    char const *thePos = inData + fOffset;
+    if (thePos == theEnd)
+      return false;
+
+    switch (fState) {
+      case kLeadingEOL: {
+        if (*thePos == '\r' || *thePos == '\n') {
+          fOffset++;
+          break;
+        }
+        fLineStart = fOffset;
+        fState = kStartLine;
+        break;
+      }
+
+      case kStartLine:
+      case kFieldLine: {
+        char const *theEOL = findEOL(thePos, theEnd);
+        if (theEOL == nullptr) {
+          fOffset = inLength;
+          return false;
+        }
+
+        fLineEnd = (UInt32) (theEOL - inData);
+        fOffset = fLineEnd + 1;
+        if (*theEOL == '\n') {
+          this->endLine(inData, false);
+        } else if (fState == kFieldLine && fLineEnd == fLineStart && fLoneCR) {
+          // \r\r, don't wait for a byte that may never come
+          this->endLine(inData, true);
+        } else {
+          fLineState = fState;
+          fState = kCR;
+        }
+        break;
+      }
+
+      case kCR: {
+        fState = fLineState;
+        if (*thePos == '\n') {
+          fOffset++;
+          this->endLine(inData, false);
+        } else {
+          this->endLine(inData, true);
+        }
+        break;
+      }
+
+      default: break;
+    }
+  }
+  return true;
+}
+
+void HTTPHeaderParser::endLine(char const *inData, bool inLoneCR) {
+  UInt32 theStart = fLineStart;
+  UInt32 theEnd = fLineEnd;
+  fLoneCR = inLoneCR;
+  fLineStart = fOffset;
+
+  if (fState == kStartLine) {
+    fStartLineOffset = theStart;
+    fStartLineLen = theEnd - theStart;
+    fFieldsOffset = fOffset;
+
+    // if this request is actually a ShoutCast password it will be in the
+    // form of "xxxxxx\r", a first line with no blanks ends the request
+    if (::memchr(inData + theStart, ' ', fStartLineLen) == nullptr)
+      fState = kDone;
+    else
+      fState = kFieldLine;
+    return;
+  }
+
+  if (theStart == theEnd) {
+    fState = kDone;
+    return;
+  }
+  this->addField(inData, theStart, theEnd);
+}
+
+void HTTPHeaderParser::addField(char const *inData, UInt32 inStart, UInt32 inEnd) {
+  // obsolete line folding is rejected (RFC 7230 3.2.4)
+  if (isBlank(inData[inStart])) {
+    fMalformed = true;
+    return;
+  }
+
+  auto *theColon = (char const *) ::memchr(inData + inStart, ':', inEnd - inStart);
+  if (theColon == nullptr || theColon == inData + inStart || fNumFields >= fMaxFields) {
+    fMalformed = true;
+    return;
+  }
+
+  if (fNumFields == fFieldsSize) {
+    UInt32 theNewSize = fFieldsSize > 0 ? fFieldsSize * 2 : (UInt32) kInitialFieldsSize;
+    if (theNewSize > fMaxFields)
+      theNewSize = fMaxFields;
+    auto *theNewFields = new Field[theNewSize];
+    if (fNumFields > 0)
+      ::memcpy(theNewFields, fFields, fNumFields * sizeof(Field));
+    delete[] fFields;
+    fFields = theNewFields;
+    fFieldsSize = theNewSize;
+  }
+
+  UInt32 theValueStart = (UInt32) (theColon - inData) + 1;
+  while (theValueStart < inEnd && isBlank(inData[theValueStart]))
+    theValueStart++;
+  UInt32 theValueEnd = inEnd;
+  while (theValueEnd > theValueStart && isBlank(inData[theValueEnd - 1]))
+    theValueEnd--;
+
+  Field &theField = fFields[fNumFields++];
+  theField.fNameOffset = inStart;
+  theField.fNameLen = (UInt32) (theColon - inData) - inStart;
+  theField.fValueOffset = theValueStart;
+  theField.fValueLen = theValueEnd - theValueStart;
+}
@@ -5,16 +5,44 @@
 #include <CF/Net/Http/HTTPListenerSocket.h>
 #include <CF/Net/Http/HTTPSession.h>
 
+#if !__WinSock__
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 namespace CF {
 namespace Net {
 
+UInt32 HTTPListenerSocket::sMaxConnections = 0;
+UInt32 HTTPListenerSocket::sMaxQueueLength = 0;
+UInt32 HTTPListenerSocket::sMaxEventLagUSec = 0;
+
+static const char sServiceUnavailable[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "Retry-After: 1\r\n"
+    "\r\n";
+
 Thread::Task *HTTPListenerSocket::GetSessionTask(TCPSocket **outSocket) {
   Assert(outSocket != nullptr);
 
+  // shed the connection before any session state is built for it
+  if (this->OverMaxConnections(1)) {
+    this->SlowDown();
+    *outSocket = nullptr;
+    return nullptr;
+  }
+
   auto *theTask = new HTTPSession();
   *outSocket = theTask->GetSocket(); // out Socket is not attached to a unix Socket yet.
 
-  if (this->OverMaxConnections(0))
+  // stop accepting once the next session would be over the limit
+  if (this->OverMaxConnections(1))
     this->SlowDown();
   else
     this->RunNormal();
@@ -22,7 +50,32 @@ Thread::Task *HTTPListenerSocket::GetSessionTask(TCPSocket **outSocket) {
   return theTask;
 }
 
+void HTTPListenerSocket::RejectConnection(int osSocket) {
+  // the send buffer of a fresh connection is empty, so this never blocks
+  // and is written entirely or not at all
+#if __WinSock__
+  (void) ::send(osSocket, sServiceUnavailable, sizeof(sServiceUnavailable) - 1, 0);
+  ::closesocket(osSocket);
+#else
+  (void) ::send(osSocket, sServiceUnavailable, sizeof(sServiceUnavailable) - 1,
+                MSG_DONTWAIT | MSG_NOSIGNAL);
+  ::close(osSocket);
+#endif
+}
+
 bool HTTPListenerSocket::OverMaxConnections(UInt32 buffer) {
+  if (sMaxConnections > 0 &&
+      HTTPSessionInterface::GetNumSessions() + buffer > sMaxConnections)
+    return true;
+
+  if (sMaxQueueLength > 0 &&
+      Thread::TaskThreadPool::GetMaxQueueLength() > sMaxQueueLength)
+    return true;
+
+  if (sMaxEventLagUSec > 0 &&
+      Socket::GetEventThread()->GetLagUSec() > sMaxEventLagUSec)
+    return true;
+
   return false;
 }
 
@@ -27,6 +27,7 @@
 #include <CF/StringTranslator.h>
 #include <CF/DateTranslator.h>
 #include <CF/Core/Thread.h>
+#include <CF/Thread/Task.h>
 #include <CF/CFEnv.h>
 
 namespace CF {
@@ -38,6 +39,7 @@ static bool sTrue = true;
 static StrPtrLen sCloseString("close", 5);
 static StrPtrLen sAllString("*", 1);
 static StrPtrLen sKeepAliveString("keep-alive", 10);
+static StrPtrLen sChunkedString("chunked", 7);
 static StrPtrLen sDefaultRealm("CxxFramework Server", 19);
 
 UInt8 HTTPPacket::sURLStopConditions[] =
@@ -70,10 +72,17 @@ UInt8 HTTPPacket::sURLStopConditions[] =
         0, 0, 0, 0, 0, 0              //250-255
     };
 
+void HTTPBodyStream::Wakeup() {
+  Thread::Task *theTask = fTask;
+  if (theTask != nullptr)
+    theTask->Signal(Thread::Task::kUpdateEvent);
+}
+
 // Constructor for parse a packet header
-HTTPPacket::HTTPPacket(StrPtrLen *packetPtr)
+HTTPPacket::HTTPPacket(StrPtrLen *packetPtr, HTTPHeaderParser *headerParser)
     : fSvrHeader(CFEnv::GetServerHeader()),
       fPacketHeader(*packetPtr), // 浅拷贝
+      fHeaderParser(headerParser),
       fMethod(httpIllegalMethod),
       fVersion(httpIllegalVersion),
       fRequestLine(),
@@ -85,18 +94,25 @@ HTTPPacket::HTTPPacket(StrPtrLen *packetPtr)
       fQueryString(nullptr),
       fQueryValues(nullptr),
       fStatusCode(httpOK),
+      fPathParams(),
+      fContext(nullptr),
+      fContextRelease(nullptr),
       fRequestKeepAlive(false), // Default value when there is no version string
       fHTTPHeader(nullptr),
       fHTTPHeaderFormatter(nullptr),
       fHTTPBody(nullptr),
-      fHTTPType(httpIllegalType) { // 未解析情况下为httpIllegalType
-
+      fBodyStream(nullptr),
+      fBodyStreamLength(-1),
+      fHTTPType(httpIllegalType), // 未解析情况下为httpIllegalType
+      fNumUnknownHeaders(0) {
+  ::memset(fUnknownSlots, 0, sizeof(fUnknownSlots));
 }
 
 // Constructor for creating a new packet
 HTTPPacket::HTTPPacket(HTTPType httpType)
     : fSvrHeader(CFEnv::GetServerHeader()),
       fPacketHeader(),
+      fHeaderParser(nullptr),
       fMethod(httpIllegalMethod),
       fVersion(httpIllegalVersion),
       fRequestLine(),
@@ -108,11 +124,18 @@ HTTPPacket::HTTPPacket(HTTPType httpType)
       fQueryString(nullptr),
       fQueryValues(nullptr),
       fStatusCode(httpOK),
+      fPathParams(),
+      fContext(nullptr),
+      fContextRelease(nullptr),
       fRequestKeepAlive(false), // Default value when there is no version string
       fHTTPHeader(nullptr),
       fHTTPHeaderFormatter(nullptr),
       fHTTPBody(nullptr),
-      fHTTPType(httpType) {
+      fBodyStream(nullptr),
+      fBodyStreamLength(-1),
+      fHTTPType(httpType),
+      fNumUnknownHeaders(0) {
+  ::memset(fUnknownSlots, 0, sizeof(fUnknownSlots));
 
   // We require the response but we allocate memory only when we call
   // CreateResponseHeader
@@ -128,11 +151,17 @@ HTTPPacket::~HTTPPacket() {
   delete[] fQueryString;
   delete fQueryValues;
   delete fHTTPBody;
+  delete fBodyStream;
+  if (fContextRelease != nullptr && fContext != nullptr)
+    fContextRelease(fContext);
 }
 
 // Parses the request
 CF_Error HTTPPacket::Parse() {
   Assert(fPacketHeader.Ptr != NULL);
+  if (fHeaderParser != nullptr && fHeaderParser->IsComplete())
+    return parseTokenizedHeader();
+
   StringParser parser(&fPacketHeader);
 
   // Store the request line (used for logging)
@@ -341,6 +370,8 @@ CF_Error HTTPPacket::parseHeaders(StringParser *parser) {
     // If the field is invalid (or unrecognized) just skip over gracefully
     if (theHeader != httpIllegalHeader)
       fFieldValues[theHeader] = theHeaderVal;
+    else
+      addUnknownHeader(theKeyWord, theHeaderVal);
 
   }
 
@@ -350,6 +381,48 @@ CF_Error HTTPPacket::parseHeaders(StringParser *parser) {
   return CF_NoErr;
 }
 
+CF_Error HTTPPacket::parseTokenizedHeader() {
+  // the first line with its EOL, parseRequestLine expects one
+  char *theBase = fPacketHeader.Ptr;
+  UInt32 theLineOffset = fHeaderParser->GetStartLineOffset();
+  fRequestLine.Set(theBase + theLineOffset, fHeaderParser->GetStartLineLen());
+  StrPtrLen theLine(theBase + theLineOffset,
+                    fHeaderParser->GetFieldsOffset() - theLineOffset);
+  StringParser parser(&theLine);
+
+  CF_Error err = parseRequestLine(&parser);
+  if (err != CF_NoErr)
+    return err;
+  if (fHTTPType == httpIllegalType) {
+    fStatusCode = httpBadRequest;
+    return CF_BadArgument;
+  }
+
+  for (UInt32 i = 0; i < fHeaderParser->GetNumFields(); i++) {
+    HTTPHeaderParser::Field const &theField = fHeaderParser->GetField(i);
+    StrPtrLen theKeyWord(theBase + theField.fNameOffset, theField.fNameLen);
+    StrPtrLen theHeaderVal(theBase + theField.fValueOffset, theField.fValueLen);
+
+    HTTPHeader theHeader = HTTPProtocol::GetHeader(&theKeyWord);
+    if (theHeader == httpConnectionHeader)
+      setKeepAlive(&theHeaderVal);
+
+    if (theHeader != httpIllegalHeader)
+      fFieldValues[theHeader] = theHeaderVal;
+    else
+      addUnknownHeader(theKeyWord, theHeaderVal);
+  }
+
+  if (fHeaderParser->IsMalformed()) {
+    // the framing of what follows can't be trusted, close the connection
+    fRequestKeepAlive = false;
+    fStatusCode = httpBadRequest;
+    return CF_BadArgument;
+  }
+
+  return CF_NoErr;
+}
+
 void HTTPPacket::setKeepAlive(StrPtrLen *keepAliveValue) {
   if (sCloseString.EqualIgnoreCase(keepAliveValue->Ptr, keepAliveValue->Len))
     fRequestKeepAlive = sFalse;
@@ -364,12 +437,68 @@ char const *HTTPPacket::GetQueryValues(char *inParam) {
   return fQueryValues->DoFindCGIValueForParam(inParam);
 }
 
+StrPtrLen *HTTPPathParams::Get(char const *inName) {
+  for (UInt32 i = 0; i < fNumParams; i++) {
+    if (fNames[i].Equal(inName))
+      return &fValues[i];
+  }
+  return nullptr;
+}
+
 StrPtrLen *HTTPPacket::GetHeaderValue(HTTPHeader inHeader) {
   if (inHeader != httpIllegalHeader)
     return &fFieldValues[inHeader];
   return NULL;
 }
 
+StrPtrLen *HTTPPacket::GetHeaderValue(const StrPtrLen &inName) {
+  HTTPHeader theHeader = HTTPProtocol::GetHeader(&inName);
+  if (theHeader != httpIllegalHeader)
+    return fFieldValues[theHeader].Len > 0 ? &fFieldValues[theHeader] : nullptr;
+
+  if (inName.Len == 0)
+    return nullptr;
+
+  UInt32 theSlot = hashUnknownHeader(inName);
+  while (fUnknownSlots[theSlot] != 0) {
+    UInt32 theIndex = fUnknownSlots[theSlot] - 1U;
+    if (fUnknownNames[theIndex].EqualIgnoreCase(inName))
+      return &fUnknownValues[theIndex];
+    theSlot = (theSlot + 1) & (kUnknownHeaderSlots - 1);
+  }
+  return nullptr;
+}
+
+UInt32 HTTPPacket::hashUnknownHeader(const StrPtrLen &inName) {
+  // FNV-1a, letters folded to lower case
+  UInt32 theHash = 2166136261U;
+  for (UInt32 i = 0; i < inName.Len; i++)
+    theHash = (theHash ^ ((UInt8) inName.Ptr[i] | 0x20U)) * 16777619U;
+  return theHash & (kUnknownHeaderSlots - 1);
+}
+
+void HTTPPacket::addUnknownHeader(StrPtrLen &inName, StrPtrLen &inValue) {
+  if (inName.Len == 0)
+    return;
+
+  UInt32 theSlot = hashUnknownHeader(inName);
+  while (fUnknownSlots[theSlot] != 0) {
+    UInt32 theIndex = fUnknownSlots[theSlot] - 1U;
+    if (fUnknownNames[theIndex].EqualIgnoreCase(inName)) {
+      fUnknownValues[theIndex] = inValue;
+      return;
+    }
+    theSlot = (theSlot + 1) & (kUnknownHeaderSlots - 1);
+  }
+
+  if (fNumUnknownHeaders == kMaxUnknownHeaders)
+    return;
+
+  fUnknownNames[fNumUnknownHeaders] = inName;
+  fUnknownValues[fNumUnknownHeaders] = inValue;
+  fUnknownSlots[theSlot] = (UInt8) (++fNumUnknownHeaders);
+}
+
 void HTTPPacket::putStatusLine(StringFormatter *putStream,
                                HTTPStatusCode status,
                                HTTPVersion version) {
@@ -479,6 +608,10 @@ void HTTPPacket::AppendConnectionCloseHeader() const {
   AppendResponseHeader(httpConnectionHeader, &sCloseString);
 }
 
+void HTTPPacket::AppendTransferEncodingChunkedHeader() const {
+  AppendResponseHeader(httpTransferEncodingHeader, &sChunkedString);
+}
+
 void HTTPPacket::AppendConnectionKeepAliveHeader() const {
   AppendResponseHeader(httpConnectionHeader, &sKeepAliveString);
 }
@@ -145,55 +145,42 @@ const StrPtrLen HTTPProtocol::sHeaders[] = {
     StrPtrLen(" ,")
 };
 
+/*
+   报文头名称的散列表：由长度、首字母和尾字母(不分大小写)散列，线性探测，
+   槽中保存 header 的枚举值 + 1，0 表示空槽。已知的报文头之间冲突很少，
+   查找一般只需要一次比较。
+ */
+UInt8 HTTPProtocol::sHeaderSlots[kHeaderSlots] = {0};
+bool HTTPProtocol::sHeaderSlotsBuilt = HTTPProtocol::buildHeaderSlots();
+
+UInt32 HTTPProtocol::hashHeader(char const *inName, UInt32 inLen) {
+  return (inLen * 63 + (inName[0] & 0x1F) * 2 + (inName[inLen - 1] & 0x1F))
+      & (kHeaderSlots - 1);
+}
+
+bool HTTPProtocol::buildHeaderSlots() {
+  for (UInt32 x = 0; x < httpNumHeaders; x++) {
+    UInt32 theSlot = hashHeader(sHeaders[x].Ptr, sHeaders[x].Len);
+    while (sHeaderSlots[theSlot] != 0)
+      theSlot = (theSlot + 1) & (kHeaderSlots - 1);
+    sHeaderSlots[theSlot] = (UInt8) (x + 1);
+  }
+  return true;
+}
+
 HTTPHeader HTTPProtocol::GetHeader(const StrPtrLen *inHeaderStr) {
   if (inHeaderStr->Len == 0)
     return httpIllegalHeader;
 
-  HTTPHeader theHeader = httpIllegalHeader;
-
-  //chances are this is one of our selected "VIP" headers. so check for this.
-  switch ((inHeaderStr->Ptr)[0]) {
-    case 'C':
-    case 'c': theHeader = httpConnectionHeader;
-      break;
-    case 'S':
-    case 's': theHeader = httpServerHeader;
-      break;
-    case 'D':
-    case 'd': theHeader = httpDateHeader;
-      break;
-    case 'A':
-    case 'a': theHeader = httpAuthorizationHeader;
-      break;
-    case 'W':
-    case 'w': theHeader = httpWWWAuthenticateHeader;
-      break;
-    case 'I':
-    case 'i': theHeader = httpIfModifiedSinceHeader;
-      break;
-    case 'E':
-    case 'e': theHeader = httpExpiresHeader;
-      break;
-    case 'L':
-    case 'l': theHeader = httpLastModifiedHeader;
-      break;
-      // Added this to optimize for HTTP tunnelling in the server (Not really a VIP header)
-    case 'X':
-    case 'x': theHeader = httpSessionCookieHeader;
-      break;
-    default: break;
+  UInt32 theSlot = hashHeader(inHeaderStr->Ptr, inHeaderStr->Len);
+  while (sHeaderSlots[theSlot] != 0) {
+    UInt32 theHeader = sHeaderSlots[theSlot] - 1U;
+    if (inHeaderStr->EqualIgnoreCase(sHeaders[theHeader].Ptr,
+                                     sHeaders[theHeader].Len))
+      return (HTTPHeader) theHeader;
+    theSlot = (theSlot + 1) & (kHeaderSlots - 1);
   }
 
-  if ((theHeader != httpIllegalHeader) &&
-      (inHeaderStr->EqualIgnoreCase(sHeaders[theHeader].Ptr,
-                                    sHeaders[theHeader].Len)))
-    return theHeader;
-
-  //If this isn't one of our VIP headers, go through the remaining request headers, trying
-  //to find the right one.
-  for (SInt32 x = httpNumVIPHeaders; x < httpNumHeaders; x++)
-    if (inHeaderStr->EqualIgnoreCase(sHeaders[x].Ptr, sHeaders[x].Len))
-      return (HTTPHeader) x;
   return httpIllegalHeader;
 }
 
@@ -29,33 +29,127 @@
 */
 
 #include <CF/Net/Http/HTTPRequestStream.h>
-#include <CF/StringParser.h>
 #include <CF/Core/Time.h>
 #include <CF/base64.h>
+#include <CF/BufferPool.h>
 
 #define READ_DEBUGGING 0
 
+using namespace CF;
 using namespace CF::Net;
 
+UInt32 HTTPRequestStream::sMaxHeaderSize = kDefaultMaxHeaderSize;
+UInt32 HTTPRequestStream::sMaxHeaderFields = kDefaultMaxHeaderFields;
+
+// Header buffers double from CF_MAX_REQUEST_BUFFER_SIZE, the common sizes are
+// pooled. Larger ones come from the heap.
+static BufferPool sBufferPools[] = {
+    {CF_MAX_REQUEST_BUFFER_SIZE},
+    {CF_MAX_REQUEST_BUFFER_SIZE * 2},
+    {CF_MAX_REQUEST_BUFFER_SIZE * 4},
+    {CF_MAX_REQUEST_BUFFER_SIZE * 8},
+    {CF_MAX_REQUEST_BUFFER_SIZE * 16},
+    {CF_MAX_REQUEST_BUFFER_SIZE * 32}
+};
+
+static char *getBuffer(UInt32 inSize) {
+  for (auto &thePool : sBufferPools)
+    if (thePool.GetBufferSize() == inSize)
+      return (char *) thePool.Get();
+  return new char[inSize];
+}
+
+static void putBuffer(char *inBuffer, UInt32 inSize) {
+  for (auto &thePool : sBufferPools) {
+    if (thePool.GetBufferSize() == inSize) {
+      thePool.Put(inBuffer);
+      return;
+    }
+  }
+  delete[] inBuffer;
+}
+
+void HTTPRequestStream::SetHeaderLimits(UInt32 inMaxHeaderSize, UInt32 inMaxHeaderFields) {
+  if (inMaxHeaderSize < kRequestBufferSizeInBytes)
+    inMaxHeaderSize = kRequestBufferSizeInBytes;
+  sMaxHeaderSize = inMaxHeaderSize;
+  sMaxHeaderFields = inMaxHeaderFields;
+}
+
 HTTPRequestStream::HTTPRequestStream(TCPSocket *sock)
     : fSocket(sock),
       fRetreatBytes(0),
       fRetreatBytesRead(0),
+      fRequestBuffer(NULL),
+      fRequestBufferSize(0),
       fCurOffset(0),
       fEncodedBytesRemaining(0),
-      fRequest(fRequestBuffer, 0),
+      fRequest(NULL, 0),
       fRequestPtr(NULL),
+      fHeaderParser(sMaxHeaderFields),
       fDecode(false),
       fPrintRTSP(false) {}
 
+HTTPRequestStream::~HTTPRequestStream() {
+  // We may have to delete this memory if it was allocated due to base64 decoding
+  if (fRequest.Ptr != fRequestBuffer)
+    delete[] fRequest.Ptr;
+
+  // a pipelined request may still be in the buffer if the session goes
+  // away early, it is dropped with the buffer
+  fRetreatBytes = fRetreatBytesRead = 0;
+  this->releaseBuffer();
+}
+
+void HTTPRequestStream::growBuffer(UInt32 inMinSize) {
+  UInt32 theSize = fRequestBufferSize > 0 ? fRequestBufferSize : (UInt32) kRequestBufferSizeInBytes;
+  while (theSize < inMinSize)
+    theSize *= 2;
+  if (theSize == fRequestBufferSize)
+    return;
+
+  char *theBuffer = getBuffer(theSize);
+  if (fCurOffset > 0)
+    ::memcpy(theBuffer, fRequestBuffer, fCurOffset);
+  if (fRequest.Ptr == fRequestBuffer)
+    fRequest.Ptr = theBuffer;
+  if (fRequestBuffer != NULL)
+    putBuffer(fRequestBuffer, fRequestBufferSize);
+
+  fRequestBuffer = theBuffer;
+  fRequestBufferSize = theSize;
+}
+
+void HTTPRequestStream::releaseBuffer() {
+  if (fRequestBuffer == NULL)
+    return;
+
+  Assert(fRetreatBytes == 0);
+  if (fRequest.Ptr == fRequestBuffer)
+    fRequest.Ptr = NULL;
+  putBuffer(fRequestBuffer, fRequestBufferSize);
+  fRequestBuffer = NULL;
+  fRequestBufferSize = 0;
+  fCurOffset = 0;
+}
+
+UInt32 HTTPRequestStream::bufferLimit() {
+  // the decoded request buffer is as large as the first buffer, see
+  // DecodeIncomingData
+  UInt32 theLimit = fDecode ? (UInt32) kRequestBufferSizeInBytes : sMaxHeaderSize;
+  return theLimit < fRequestBufferSize ? theLimit : fRequestBufferSize;
+}
+
 void HTTPRequestStream::SnarfRetreat(HTTPRequestStream &fromRequest) {
   // Simplest thing to do is to just completely blow away everything in this current
   // stream, and replace it with the retreat bytes from the other stream.
   fRequestPtr = NULL;
-  Assert(fRetreatBytes < kRequestBufferSizeInBytes);
-  fRetreatBytes = fromRequest.fRetreatBytes;
+  fHeaderParser.Reset();
   fEncodedBytesRemaining = fCurOffset = fRequest.Len = 0;
-  ::memcpy(&fRequestBuffer[0],
+  Assert(fromRequest.fRetreatBytes < kRequestBufferSizeInBytes); // it gets decoded
+  this->growBuffer(fromRequest.fRetreatBytes + 1);
+  fRetreatBytes = fromRequest.fRetreatBytes;
+  ::memcpy(fRequestBuffer,
            fromRequest.fRequest.Ptr + fromRequest.fRequest.Len,
            fromRequest.fRetreatBytes);
 }
@@ -71,6 +165,7 @@ CF_Error HTTPRequestStream::ReadRequest() {
     // part of a new request
     if (fRequestPtr != NULL) {
       fRequestPtr = NULL; // flag that we no longer have a complete request
+      fHeaderParser.Reset();
 
       // Take all the retreated leftover data and move it to the beginning of the buffer
       if ((fRetreatBytes > 0) && (fRequest.Len > 0))
@@ -100,12 +195,18 @@ CF_Error HTTPRequestStream::ReadRequest() {
                   &fRequestBuffer[fCurOffset - fEncodedBytesRemaining],
                   fEncodedBytesRemaining);
         fCurOffset = fRetreatBytes + fEncodedBytesRemaining;
-        Assert(fCurOffset < kRequestBufferSizeInBytes);
+        Assert(fCurOffset < fRequestBufferSize);
       } else
         fCurOffset = fRetreatBytes;
 
       newOffset = fRequest.Len = fRetreatBytes;
       fRetreatBytes = fRetreatBytesRead = 0;
+
+      // keep-alive and nothing pipelined: don't hold the memory while idle
+      if (fCurOffset == 0 && !fDecode) {
+        this->releaseBuffer();
+        fHeaderParser.Release();
+      }
     }
 
     // We don't have any new data, so try and get some
@@ -121,17 +222,22 @@ CF_Error HTTPRequestStream::ReadRequest() {
       } else {
         // We don't have any new data, get some from the Socket...
         // 注意我们的 Socket 端口是 non blocking
+        if (fRequestBuffer == NULL)
+          this->growBuffer(kRequestBufferSizeInBytes);
         CF_Error sockErr = fSocket->Read(
             &fRequestBuffer[fCurOffset],
-            (kRequestBufferSizeInBytes - fCurOffset) - 1,
+            (this->bufferLimit() - fCurOffset) - 1,
             &newOffset);
         // assume the client is dead if we get an error back
 #if __WinSock__
-        if (sockErr == WSAEWOULDBLOCK)
+        if (sockErr == WSAEWOULDBLOCK) {
 #else
-        if (sockErr == EAGAIN)
+        if (sockErr == EAGAIN) {
 #endif
+          if (fCurOffset == 0 && fRequest.Ptr == fRequestBuffer)
+            this->releaseBuffer();
           return CF_NoErr;
+        }
         if (sockErr != CF_NoErr) {
           Assert(!fSocket->IsConnected());
           return sockErr;
@@ -151,7 +257,7 @@ CF_Error HTTPRequestStream::ReadRequest() {
         if (decodeErr == CF_NoErr) Assert(fEncodedBytesRemaining < 4);
       } else
         fRequest.Len += newOffset;
-      Assert(fRequest.Len < kRequestBufferSizeInBytes);
+      Assert(fRequest.Len < fRequestBufferSize);
       fCurOffset += newOffset;
     }
     Assert(newOffset > 0);
@@ -211,60 +317,38 @@ CF_Error HTTPRequestStream::ReadRequest() {
       str.PrintStrEOL("\n\r\n", "\n");
     }
 
-    // use a StringParser object to search for a double EOL, which signifies
-    // the end of the header.
-    bool weAreDone = false;
-    StringParser headerParser(&fRequest);
-
-    UInt16 lcount = 0;
-    while (headerParser.GetThruEOL(NULL)) {
-      lcount++;
-      if (headerParser.ExpectEOL()) {
-        // The legal end-of-header sequences are \r\r, \r\n\r\n, & \n\n.
-        // NOT \r\n\r!
-        // If the packets arrive just a certain way, we could get here with
-        // the latter combo, and not wait for a final \n.
-        if ((headerParser.GetDataParsedLen() > 2) &&
-            (memcmp(headerParser.GetCurrentPosition() - 3, "\r\n\r", 3) == 0))
-          continue;
-        weAreDone = true;
-        break;
-      } else if (lcount == 1) {
-        // if this request is actually a ShoutCast password it will be
-        // in the form of "xxxxxx\r" where "xxxxx" is the password.
-        // If we get a 1st request line ending in \r with no blanks we will
-        // assume that this is the end of the request.
-        UInt16 flag = 0;
-        UInt16 i = 0;
-        for (i = 0; i < fRequest.Len; i++) {
-          if (fRequest.Ptr[i] == ' ')
-            flag++;
-        }
-        if (flag == 0) {
-          weAreDone = true;
-          break;
-        }
-      }
-    }
-
-    // weAreDone means we have gotten a full request
-    if (weAreDone) {
+    // Only the bytes that arrived since the last call are scanned, the
+    // parser picks up where it stopped.
+    if (fHeaderParser.Parse(fRequest.Ptr, fRequest.Len)) {
       // put back any data that is not part of the header
-      fRequest.Len -= headerParser.GetDataRemaining();
-      fRetreatBytes += headerParser.GetDataRemaining();
+      UInt32 theHeaderLen = fHeaderParser.GetHeaderLength();
+      fRetreatBytes += fRequest.Len - theHeaderLen;
+      fRequest.Len = theHeaderLen;
 
       fRequestPtr = &fRequest;
       return CF_RequestArrived;
     }
 
-    // check for a full buffer
-    if (fCurOffset == kRequestBufferSizeInBytes - 1) {
+    // check for a full buffer, grow it up to the limit
+    if (fCurOffset == this->bufferLimit() - 1) {
+      if (this->bufferLimit() == fRequestBufferSize && fRequestBufferSize < sMaxHeaderSize && !fDecode) {
+        this->growBuffer(fRequestBufferSize * 2);
+        continue;
+      }
       fRequestPtr = &fRequest;
       return (CF_Error) E2BIG;
     }
   }
 }
 
+bool HTTPRequestStream::HasBufferedRequest() {
+  if (fRequestPtr == NULL || fRetreatBytes == 0 || fDecode)
+    return false;
+
+  HTTPHeaderParser theParser;
+  return theParser.Parse(fRequest.Ptr + fRequest.Len + fRetreatBytesRead, fRetreatBytes);
+}
+
 CF_Error HTTPRequestStream::Read(void *ioBuffer,
                                  UInt32 inBufLen,
                                  UInt32 *outLengthRead) {
@@ -302,16 +386,28 @@ CF_Error HTTPRequestStream::Read(void *ioBuffer,
   }
 
   //
-  // Read data directly from the Socket and place it in our buffer
-  UInt32 theNewOffset = 0;
-  CF_Error theErr = fSocket->Read(&theIoBuffer[theLengthRead],
-                                  inBufLen - theLengthRead,
-                                  &theNewOffset);
+  // Read data directly from the Socket and place it in our buffer.
+  // In ET mode keep reading until the buffer is full or the Socket is
+  // drained (EAGAIN), otherwise no further edge will be reported.
+  CF_Error theErr = CF_NoErr;
+  do {
+    UInt32 theNewOffset = 0;
+    theErr = fSocket->Read(&theIoBuffer[theLengthRead],
+                           inBufLen - theLengthRead,
+                           &theNewOffset);
 #if READ_DEBUGGING
-  s_printf("In RTSPRequestStream::Read: Got %d bytes off Socket\n", theNewOffset);
+    s_printf("In RTSPRequestStream::Read: Got %d bytes off Socket\n", theNewOffset);
 #endif
+    if (theErr != CF_NoErr) break;
+    theLengthRead += theNewOffset;
+  } while (fSocket->IsETMode() && theLengthRead < inBufLen);
+
   if (outLengthRead != NULL)
-    *outLengthRead = theNewOffset + theLengthRead;
+    *outLengthRead = theLengthRead;
+
+  // report the data first, a Socket error will show up again on the next call
+  if (theLengthRead > 0)
+    theErr = CF_NoErr;
 
   return theErr;
 }
@@ -320,7 +416,7 @@ CF_Error HTTPRequestStream::DecodeIncomingData(char *inSrcData,
                                                UInt32 inSrcDataLen) {
   Assert(fRetreatBytes == 0);
 
-  if (fRequest.Ptr == &fRequestBuffer[0]) {
+  if (fRequest.Ptr == fRequestBuffer) {
     fRequest.Ptr = new char[kRequestBufferSizeInBytes];
     fRequest.Len = 0;
   }
@@ -152,10 +152,18 @@ CF_Error HTTPResponseStream::Flush() {
       str.PrintStrEOL();
     }
 
+    // In ET mode keep sending until everything is out or the Socket is
+    // flow-controlled (EAGAIN), otherwise no further edge will be reported.
     UInt32 theLengthSent = 0;
-    (void) fSocket->Send(this->GetBufPtr() + fBytesSentInBuffer,
-                         amtInBuffer,
-                         &theLengthSent);
+    while (theLengthSent < amtInBuffer) {
+      UInt32 theChunkSent = 0;
+      OS_Error theErr = fSocket->Send(this->GetBufPtr() + fBytesSentInBuffer + theLengthSent,
+                                      amtInBuffer - theLengthSent,
+                                      &theChunkSent);
+      if (theErr != OS_NoErr) break;
+      theLengthSent += theChunkSent;
+      if (!fSocket->IsETMode()) break;
+    }
 
     // Refresh the timeout if we were able to send any data
     if (theLengthSent > 0)
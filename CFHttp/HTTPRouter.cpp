@@ -0,0 +1,308 @@
+#include <string.h>
+#include <CF/Net/Http/HTTPRouter.h>
+#include <CF/Net/Http/HTTPDispatcher.h>
+
+using namespace CF::Net;
+
+HTTPRouter::Node::Node(char const *inLabel, UInt32 inLen)
+    : fLabel(nullptr),
+      fLabelLen(inLen),
+      fIndices(nullptr),
+      fChildren(nullptr),
+      fNumChildren(0),
+      fParamChild(nullptr),
+      fParamName(),
+      fExact(nullptr),
+      fPrefix(nullptr) {
+  if (inLen > 0) {
+    fLabel = new char[inLen];
+    ::memcpy(fLabel, inLabel, inLen);
+  }
+}
+
+HTTPRouter::Node::~Node() {
+  for (UInt32 i = 0; i < fNumChildren; i++)
+    delete fChildren[i];
+  delete fParamChild;
+  delete[] fChildren;
+  delete[] fIndices;
+  delete[] fLabel;
+  delete[] fParamName.Ptr;
+}
+
+HTTPRouter::Node *HTTPRouter::Node::findChild(char inByte) {
+  if (fNumChildren == 0)
+    return nullptr;
+  auto *theIndex = (char *) ::memchr(fIndices, inByte, fNumChildren);
+  return theIndex != nullptr ? fChildren[theIndex - fIndices] : nullptr;
+}
+
+void HTTPRouter::Node::addChild(Node *inChild) {
+  Assert(inChild->fLabelLen > 0);
+
+  // the table is built once, grow one by one
+  auto *theIndices = new char[fNumChildren + 1];
+  auto **theChildren = new Node *[fNumChildren + 1];
+  if (fNumChildren > 0) {
+    ::memcpy(theIndices, fIndices, fNumChildren);
+    ::memcpy(theChildren, fChildren, fNumChildren * sizeof(Node *));
+  }
+  theIndices[fNumChildren] = inChild->fLabel[0];
+  theChildren[fNumChildren] = inChild;
+
+  delete[] fIndices;
+  delete[] fChildren;
+  fIndices = theIndices;
+  fChildren = theChildren;
+  fNumChildren++;
+}
+
+void HTTPRouter::Node::split(UInt32 inLen) {
+  Assert(inLen > 0 && inLen < fLabelLen);
+
+  auto *theRest = new Node(fLabel + inLen, fLabelLen - inLen);
+  theRest->fIndices = fIndices;
+  theRest->fChildren = fChildren;
+  theRest->fNumChildren = fNumChildren;
+  theRest->fParamChild = fParamChild;
+  theRest->fExact = fExact;
+  theRest->fPrefix = fPrefix;
+
+  fLabelLen = inLen;
+  fIndices = nullptr;
+  fChildren = nullptr;
+  fNumChildren = 0;
+  fParamChild = nullptr;
+  fExact = nullptr;
+  fPrefix = nullptr;
+  this->addChild(theRest);
+}
+
+HTTPRouter::HTTPRouter()
+    : fTree(nullptr, 0), fExtensionTree(nullptr, 0), fDefault(nullptr) {
+}
+
+bool HTTPRouter::Add(char const *inPath, HTTPPathMapper *inMapper) {
+  auto theLen = (UInt32) ::strlen(inPath);
+
+  switch (inMapper->ItsType()) {
+    case HTTPPathMapper::httpExactMapper:
+      return this->addExact(inPath, theLen, inMapper);
+
+    case HTTPPathMapper::httpWildcardMapper: {
+      // "xxxxx/*" matches what starts with "xxxxx"
+      Node *theNode = insertStatic(&fTree, inPath, theLen - 2);
+      if (theNode->fPrefix != nullptr) return false;
+      theNode->fPrefix = inMapper;
+      return true;
+    }
+
+    case HTTPPathMapper::httpExtensionMapper: {
+      // "*.ext" matches what ends with ".ext"
+      UInt32 theExtLen = theLen - 1;
+      auto *theReversed = new char[theExtLen];
+      for (UInt32 i = 0; i < theExtLen; i++)
+        theReversed[i] = inPath[theLen - 1 - i];
+      Node *theNode = insertStatic(&fExtensionTree, theReversed, theExtLen);
+      delete[] theReversed;
+      if (theNode->fPrefix != nullptr) return false;
+      theNode->fPrefix = inMapper;
+      return true;
+    }
+
+    case HTTPPathMapper::httpDefaultMapper:
+      if (fDefault != nullptr) return false;
+      fDefault = inMapper;
+      return true;
+
+    default: return false;
+  }
+}
+
+bool HTTPRouter::addExact(char const *inPath, UInt32 inLen, HTTPPathMapper *inMapper) {
+  // the static parts around the {name} segments; all is checked before
+  // anything is inserted, a rejected route leaves no nodes behind
+  UInt32 theStarts[HTTPPathParams::kMaxParams + 1];
+  UInt32 theLens[HTTPPathParams::kMaxParams + 1];
+  StrPtrLen theNames[HTTPPathParams::kMaxParams];
+  UInt32 theNumParams = 0;
+  UInt32 thePos = 0;
+
+  while (true) {
+    auto *theOpen = (char const *) ::memchr(inPath + thePos, '{', inLen - thePos);
+    UInt32 theStatic = theOpen != nullptr ? (UInt32) (theOpen - inPath) : inLen;
+    theStarts[theNumParams] = thePos;
+    theLens[theNumParams] = theStatic - thePos;
+    if (theOpen == nullptr)
+      break;
+
+    // a parameter is a whole segment: ".../{name}/..." or ".../{name}"
+    auto *theClose = (char const *) ::memchr(theOpen, '}', inLen - theStatic);
+    if (theStatic == 0 || inPath[theStatic - 1] != '/' || theClose == nullptr)
+      return false;
+    UInt32 theEnd = (UInt32) (theClose - inPath) + 1;
+    if (theEnd < inLen && inPath[theEnd] != '/')
+      return false;
+    StrPtrLen theName((char *) theOpen + 1, (UInt32) (theClose - theOpen) - 1);
+    if (theName.Len == 0 || theNumParams == HTTPPathParams::kMaxParams)
+      return false;
+
+    theNames[theNumParams++] = theName;
+    thePos = theEnd;
+  }
+
+  // walk what is there: "/a/{id}" and "/a/{name}" can't tell which one
+  // is meant, a route may be added only once
+  Node *theNode = &fTree;
+  for (UInt32 i = 0; theNode != nullptr; i++) {
+    theNode = findStatic(theNode, inPath + theStarts[i], theLens[i]);
+    if (theNode == nullptr)
+      break;  // new from here on
+    if (i == theNumParams) {
+      if (theNode->fExact != nullptr)
+        return false;
+      break;
+    }
+    theNode = theNode->fParamChild;
+    if (theNode != nullptr && !theNode->fParamName.Equal(theNames[i]))
+      return false;
+  }
+
+  theNode = &fTree;
+  for (UInt32 i = 0; i < theNumParams; i++) {
+    theNode = insertStatic(theNode, inPath + theStarts[i], theLens[i]);
+    if (theNode->fParamChild == nullptr) {
+      theNode->fParamChild = new Node(nullptr, 0);
+      theNode->fParamChild->fParamName.Set(theNames[i].GetAsCString(), theNames[i].Len);
+    }
+    theNode = theNode->fParamChild;
+  }
+  theNode = insertStatic(theNode, inPath + theStarts[theNumParams], theLens[theNumParams]);
+
+  Assert(theNode->fExact == nullptr);
+  theNode->fExact = inMapper;
+  return true;
+}
+
+HTTPRouter::Node *HTTPRouter::findStatic(Node *inNode, char const *inBytes, UInt32 inLen) {
+  while (inLen > 0 && inNode != nullptr) {
+    Node *theChild = inNode->findChild(inBytes[0]);
+    if (theChild == nullptr || theChild->fLabelLen > inLen
+        || ::memcmp(theChild->fLabel, inBytes, theChild->fLabelLen) != 0)
+      return nullptr;
+
+    inNode = theChild;
+    inBytes += theChild->fLabelLen;
+    inLen -= theChild->fLabelLen;
+  }
+  return inNode;
+}
+
+HTTPRouter::Node *HTTPRouter::insertStatic(Node *ioNode, char const *inBytes, UInt32 inLen) {
+  while (inLen > 0) {
+    Node *theChild = ioNode->findChild(inBytes[0]);
+    if (theChild == nullptr) {
+      theChild = new Node(inBytes, inLen);
+      ioNode->addChild(theChild);
+      return theChild;
+    }
+
+    UInt32 theCommon = 1;
+    while (theCommon < theChild->fLabelLen && theCommon < inLen
+        && theChild->fLabel[theCommon] == inBytes[theCommon])
+      theCommon++;
+    if (theCommon < theChild->fLabelLen)
+      theChild->split(theCommon);
+
+    ioNode = theChild;
+    inBytes += theCommon;
+    inLen -= theCommon;
+  }
+  return ioNode;
+}
+
+HTTPPathMapper *HTTPRouter::Match(StrPtrLen &inPath, HTTPPathParams *outParams) {
+  if (outParams != nullptr)
+    outParams->Clear();
+
+  HTTPPathMapper *theMapper = matchExact(&fTree, inPath.Ptr, inPath.Len, outParams);
+  if (theMapper == nullptr)
+    theMapper = matchPrefix(&fTree, inPath.Ptr, inPath.Len, false);
+  if (theMapper == nullptr)
+    theMapper = matchPrefix(&fExtensionTree, inPath.Ptr, inPath.Len, true);
+  if (theMapper == nullptr)
+    theMapper = fDefault;
+  return theMapper;
+}
+
+HTTPPathMapper *HTTPRouter::matchExact(Node *inNode, char const *inPath, UInt32 inLen,
+                                       HTTPPathParams *outParams) {
+  if (inLen == 0)
+    return inNode->fExact;
+
+  HTTPPathMapper *theMapper = nullptr;
+
+  // static segments first
+  Node *theChild = inNode->findChild(inPath[0]);
+  if (theChild != nullptr && theChild->fLabelLen <= inLen
+      && ::memcmp(theChild->fLabel, inPath, theChild->fLabelLen) == 0) {
+    theMapper = matchExact(theChild, inPath + theChild->fLabelLen,
+                           inLen - theChild->fLabelLen, outParams);
+    if (theMapper != nullptr)
+      return theMapper;
+  }
+
+  // then the parameter, it takes the segment up to the next '/'
+  Node *theParam = inNode->fParamChild;
+  if (theParam == nullptr)
+    return nullptr;
+
+  auto *theSlash = (char const *) ::memchr(inPath, '/', inLen);
+  UInt32 theSegment = theSlash != nullptr ? (UInt32) (theSlash - inPath) : inLen;
+  if (theSegment == 0)
+    return nullptr;
+
+  UInt32 theNumParams = 0;
+  if (outParams != nullptr) {
+    theNumParams = outParams->fNumParams;
+    outParams->fNames[theNumParams] = theParam->fParamName;
+    outParams->fValues[theNumParams].Set((char *) inPath, theSegment);
+    outParams->fNumParams++;
+  }
+
+  theMapper = matchExact(theParam, inPath + theSegment, inLen - theSegment, outParams);
+
+  if (theMapper == nullptr && outParams != nullptr)
+    outParams->fNumParams = theNumParams;  // not this way, drop the value
+  return theMapper;
+}
+
+HTTPPathMapper *HTTPRouter::matchPrefix(Node *inNode, char const *inPath, UInt32 inLen,
+                                        bool inReverse) {
+  HTTPPathMapper *theMapper = inNode->fPrefix;
+  UInt32 thePos = 0;
+
+  while (thePos < inLen) {
+    char theByte = inReverse ? inPath[inLen - 1 - thePos] : inPath[thePos];
+    Node *theChild = inNode->findChild(theByte);
+    if (theChild == nullptr || theChild->fLabelLen > inLen - thePos)
+      break;
+
+    UInt32 i = 1;
+    for (; i < theChild->fLabelLen; i++) {
+      UInt32 theIndex = thePos + i;
+      char theNext = inReverse ? inPath[inLen - 1 - theIndex] : inPath[theIndex];
+      if (theChild->fLabel[i] != theNext)
+        break;
+    }
+    if (i < theChild->fLabelLen)
+      break;
+
+    thePos += theChild->fLabelLen;
+    inNode = theChild;
+    if (inNode->fPrefix != nullptr)
+      theMapper = inNode->fPrefix;
+  }
+
+  return theMapper;
+}
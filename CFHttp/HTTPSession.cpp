@@ -4,6 +4,7 @@
 */
 
 #include <CF/CFEnv.h>
+#include <CF/Core/Time.h>
 #include <CF/Net/Http/HTTPSession.h>
 
 #if __FreeBSD__ || __hpux__
@@ -20,6 +21,16 @@ HTTPSession::HTTPSession()
       fRequest(nullptr),
       fResponse(nullptr),
       fReadMutex(),
+      fBodyType(kBodyNone),
+      fBodyRemaining(0),
+      fBodyMapper(nullptr),
+      fBodyBuffer(nullptr),
+      fBodyLength(0),
+      fBodyCapacity(0),
+      fResponseChunked(false),
+      fResponseRemaining(-1),
+      fCompletion(nullptr),
+      fCGIDeadline(0),
       fState(kReadingFirstRequest) {
   this->SetTaskName("HTTPSession");
 }
@@ -33,6 +44,10 @@ HTTPSession::~HTTPSession() {
 
   fLiveSession = false; //used in Clean up request to remove the RTP session.
   this->CleanupRequestAndResponse();// Make sure that all our objects are deleted
+
+  // Run doesn't let the session go before the CGI completed
+  if (fCompletion != nullptr)
+    fCompletion->Release();
 }
 
 SInt64 HTTPSession::Run() {
@@ -46,10 +61,26 @@ SInt64 HTTPSession::Run() {
     fLiveSession = false;
 
   if (events & Thread::Task::kTimeoutEvent) {
-    /* Session超时,释放Session */
-    return -1;
+    /* Session超时,释放Session; 异步 CGI 未结束时要等它结束 */
+    if (fCompletion == nullptr)
+      return -1;
+    fLiveSession = false;
   }
 
+  /* 对端已挂断或 Socket 出错，不必再读写，直接清理 Session */
+  if (fSocket.IsHangUp())
+    fLiveSession = false;
+
+  /*
+     仅有可写事件时，只有发送中的 Session 需要运行，读取状态下直接返回，
+     避免一次无效的 read
+   */
+  if ((events & Thread::Task::kWriteEvent) && !(events & Thread::Task::kReadEvent)
+      && fLiveSession
+      && (fState == kReadingRequest || fState == kReadingFirstRequest)
+      && fOutputStream.GetUnsentLength() == 0)
+    return 0;
+
   while (this->IsLiveSession()) {
     switch (fState) {
       case kReadingFirstRequest: {
@@ -85,6 +116,17 @@ SInt64 HTTPSession::Run() {
         Core::MutexLocker readMutexLocker(&fReadMutex);
 
         if ((err = fInputStream.ReadRequest()) == CF_NoErr) {
+          /* 批量处理的流水线请求已全部处理完，在等待新数据之前发出积攒的响应 */
+          if (fOutputStream.GetUnsentLength() > 0) {
+            err = fOutputStream.Flush();
+            if (err == EAGAIN) {
+              fSocket.RequestEvent(EV_WR);
+              return 0;
+            } else if (err != CF_NoErr) {
+              Assert(!this->IsLiveSession());
+              break;
+            }
+          }
           fInputSocketP->RequestEvent(EV_RE);
           return 0;
         }
@@ -120,7 +162,8 @@ SInt64 HTTPSession::Run() {
 
         Assert(fRequest == nullptr);
         Assert(fResponse == nullptr);
-        fRequest = new HTTPPacket(fInputStream.GetRequestBuffer());
+        fRequest = new HTTPPacket(fInputStream.GetRequestBuffer(),
+                                  fInputStream.GetHeaderParser());
         fResponse = new HTTPPacket(httpResponseType);
 
         /*
@@ -134,7 +177,8 @@ SInt64 HTTPSession::Run() {
         fOutputStream.ResetBytesWritten();
 
         if (err == E2BIG) {
-          fResponse->SetStatusCode(httpInternalServerError);
+          // the header is over the limit, the connection is closed afterwards
+          fResponse->SetStatusCode(httpBadRequest);
           fState = kSendingResponse;
           break;
         }
@@ -161,6 +205,10 @@ SInt64 HTTPSession::Run() {
 
         /* 当 SetupRequest 步骤未读取到完整的网络报文，需要进行等待 */
         if (theErr == CF_WouldBlock) {
+          // the client may wait for earlier pipelined responses, don't hold
+          // them back while the body trickles in; what doesn't fit goes out
+          // with the next flush
+          (void) fOutputStream.Flush();
           this->ForceSameThread();
           fInputSocketP->RequestEvent(EV_RE);
           // We are holding mutexes, so we need to force
@@ -170,6 +218,23 @@ SInt64 HTTPSession::Run() {
           return 0;
         }
 
+        /* 客户端已断开 */
+        if (theErr == CF_RequestFailed) {
+          fRequest->SetKeepAlive(false);
+          fState = kCleaningUp;
+          break;
+        }
+
+        /*
+           报文头或请求体格式错误、请求体过大等，状态码已由 SetupRequest 设置。
+           请求体的剩余部分无法跳过，响应后关闭连接
+         */
+        if (theErr == CF_BadArgument) {
+          fRequest->SetKeepAlive(false);
+          fState = kSendingResponse;
+          break;
+        }
+
         fState = kPreprocessingRequest;
         break;
       }
@@ -189,14 +254,72 @@ SInt64 HTTPSession::Run() {
       case kProcessingRequest: {
 
         // doDispatch
-        CF_Error theErr = sDispatcher->Dispatch(*fRequest, *fResponse);
-        if (theErr == CF_FileNotFound) {
-          fResponse->SetStatusCode(httpNotFound);
-        } else if (theErr != CF_NoErr) {
-          fResponse->SetStatusCode(httpInternalServerError);
+        HTTPPathMapper *theMapper = sDispatcher->Match(*fRequest);
+        CF_Error theErr = CF_FileNotFound;
+
+        if (theMapper != nullptr && theMapper->IsAsync()) {
+          fCompletion = new HTTPCompletion(this, sCGITimeoutInMsec);
+          theErr = theMapper->MappingAsync(*fRequest, *fResponse, fCompletion);
+
+          if (theErr == CF_WouldBlock) {
+            /*
+               CGI 稍后完成，期间不占用线程。Complete 通过 kUpdateEvent 唤醒
+               Session，截止时间由 idle timer 以 kIdleEvent 唤醒
+             */
+            fCGIDeadline = Core::Time::Milliseconds() + fCompletion->GetTimeout();
+            this->SetIdleTimer(fCompletion->GetTimeout());
+            fState = kWaitingForCGI;
+            this->ForceSameThread();
+            // We are holding mutexes, so we need to force
+            // the same Thread to be used for next Run()
+            return 0;
+          }
+
+          // answered right away, the completion is not used
+          delete fCompletion;
+          fCompletion = nullptr;
+        } else if (theMapper != nullptr) {
+          theErr = theMapper->Mapping(*fRequest, *fResponse);
         }
 
+        this->setCGIStatus(theErr);
         fState = kSendingResponse;
+        break;
+      }
+
+      case kWaitingForCGI: {
+        CF_Error theErr;
+        if (fCompletion->IsCompleted(&theErr)) {
+          this->CancelTimeout();
+          fCompletion->Release();
+          fCompletion = nullptr;
+
+          this->setCGIStatus(theErr);
+          fState = kSendingResponse;
+          break;
+        }
+
+        if (Core::Time::Milliseconds() < fCGIDeadline) {
+          // woken up early, the idle timer is still pending
+          this->ForceSameThread();
+          return 0;
+        }
+
+        /*
+           超时：request/response 交给仍在运行的 CGI，另以 504 响应。
+           request 所在的缓冲区还在使用，响应后关闭连接
+         */
+        HTTPVersion theVersion = fRequest->GetVersion();
+        if (fCompletion->Detach(fRequest, fResponse)) {
+          fRequest = new HTTPPacket(httpRequestType);
+          fRequest->SetVersion(theVersion);
+          fRequest->SetKeepAlive(false);
+          fResponse = new HTTPPacket(httpResponseType);
+          fResponse->SetStatusCode(httpGatewayTimeout);
+          fState = kSendingResponse;
+        }
+        // otherwise the CGI completed in the meantime
+        break;
       }
 
       case kSendingResponse: {
@@ -205,13 +328,51 @@ SInt64 HTTPSession::Run() {
         Assert(fResponse != nullptr);
 
         /* 构造响应信息 */
-        CF_Error theErr = SetupResponse();
+        (void) SetupResponse();
+
+        /* 响应头已写入，再次运行时不能重复构造 */
+        fState = kSendingResponseBody;
+      }
+
+      case kSendingResponseBody: {
+        /* 流式的响应体：边生成边发送 */
+        if (fResponse->GetBodyStream() != nullptr) {
+          err = this->sendResponseBody();
+
+          if (err == EAGAIN) {
+            fSocket.RequestEvent(EV_WR);
+            this->ForceSameThread();
+            return 0;
+          } else if (err == CF_WouldBlock) {
+            // the generator has nothing yet, what it produced so far is out;
+            // it signals kUpdateEvent when it has more, the idle timer is
+            // the fallback (a Task waiting on its Run timeout can't be woken)
+            this->SetIdleTimer(kBodyStreamRetryMSec);
+            this->ForceSameThread();
+            return 0;
+          } else if (err != CF_NoErr) {
+            Assert(!this->IsLiveSession());
+            break;
+          }
+        }
 
         if (fOutputStream.GetBytesWritten() == 0) {
           fState = kCleaningUp;
           break;
         }
 
+        /*
+           HTTP 流水线：下一个请求已完整地在缓冲区中，先不发送，把这一批请求
+           的响应积攒起来，在一次 Send 中发出。请求不保活、积攒过多或者需要
+           等待网络数据时(见 kReadingRequest)才发送。
+         */
+        if (fRequest->IsRequestKeepAlive()
+            && fInputStream.HasBufferedRequest()
+            && fOutputStream.GetUnsentLength() < kMaxPipelinedResponseBytes) {
+          fState = kCleaningUp;
+          break;
+        }
+
         /* 发送响应报文 */
         err = fOutputStream.Flush();
 
@@ -249,15 +410,41 @@ SInt64 HTTPSession::Run() {
 
         /* 一次请求的读取、处理、响应过程完整，等待下一次网络报文！ */
         this->CleanupRequestAndResponse();
+        fSocket.TrimSndBuf(); // 空闲期间不占用预算
         fState = kReadingRequest;
+
+        /* 超时的 CGI 仍在使用请求缓冲区，不能再读取 */
+        if (fCompletion != nullptr) {
+          fLiveSession = false;
+          break;
+        }
       }
       default: break;
     }
   }
 
+  /* 等待中的 CGI 仍在使用 request/response，交给它释放 */
+  if (fState == kWaitingForCGI && fCompletion != nullptr
+      && fCompletion->Detach(fRequest, fResponse)) {
+    fRequest = nullptr;
+    fResponse = nullptr;
+    fState = kCleaningUp;
+  }
+
   /* 清空Session占用的所有资源 */
   this->CleanupRequestAndResponse();
 
+  /* CGI 结束(kUpdateEvent)之前 Session 不能删除，请求缓冲区仍在使用 */
+  if (fCompletion != nullptr) {
+    if (!fCompletion->IsCompleted(nullptr)) {
+      fSocket.Cleanup(); // the client needn't wait for the close
+      return 0;
+    }
+    this->CancelTimeout();
+    fCompletion->Release();
+    fCompletion = nullptr;
+  }
+
   /* Session引用数为0，返回-1后，系统会将此Session删除 */
   if (fObjectHolders == 0)
     return -1;
@@ -280,12 +467,8 @@ CF_Error HTTPSession::SendHTTPPacket(CF::StrPtrLen *contentXML,
   if (connectionClose)
     httpAck.AppendConnectionCloseHeader();
 
-  char respHeader[2048] = {0};
-  StrPtrLen *ackPtr = httpAck.GetCompleteHTTPHeader();
-  strncpy(respHeader, ackPtr->Ptr, ackPtr->Len);
-
   HTTPResponseStream *pOutputStream = GetOutputStream();
-  pOutputStream->Put(respHeader);
+  pOutputStream->Put(*httpAck.GetCompleteHTTPHeader());
   if (contentXML->Len > 0)
     pOutputStream->Put(contentXML->Ptr, contentXML->Len);
 
@@ -312,70 +495,193 @@ CF_Error HTTPSession::SetupRequest() {
   /* 解析 head */
   if (fRequest->GetHTTPType() == httpIllegalType) {
     theErr = fRequest->Parse();
-    if (theErr != CF_NoErr)
+    if (theErr != CF_NoErr) {
+      fResponse->SetStatusCode(httpBadRequest);
       return CF_BadArgument;
+    }
+
+    theErr = this->startRequestBody();
+    if (theErr != CF_NoErr)
+      return theErr;
   }
 
-  /* 解析 body */
-  StrPtrLen *lengthPtr = fRequest->GetHeaderValue(httpContentLengthHeader);
-  StringParser theContentLenParser(lengthPtr);
-  theContentLenParser.ConsumeWhitespace();
-  UInt32 content_length = theContentLenParser.ConsumeInteger(nullptr);
-
-  if (content_length) {
-    s_printf("HTTPSession read content-length:%d \n", content_length);
-    // Check for the existence of 2 attributes in the request: a pointer to our buffer for
-    // the request body, and the current offset in that buffer. If these attributes exist,
-    // then we've already been here for this request. If they don't exist, add them.
-    UInt32 theBufferOffset = 0;
-    char *theRequestBody = nullptr;
-    StrPtrLen *requestBody = fRequest->GetBody();
-    if (requestBody != nullptr) {
-      theRequestBody = requestBody->Ptr;
-      theBufferOffset = requestBody->Len;
-    } else {
-      theRequestBody = new char[content_length + 1];
-      memset(theRequestBody, 0, content_length + 1);
-      requestBody = new StrPtrLenDel(theRequestBody, 0);
-      fRequest->SetBody(requestBody);
-    }
+  /* 读取 body，未读完时返回 CF_WouldBlock */
+  if (fBodyType != kBodyNone)
+    return this->readRequestBody();
 
-    UInt32 theLen;
+  return CF_NoErr;
+}
+
+CF_Error HTTPSession::startRequestBody() {
+  fBodyType = kBodyNone;
 
-    // We have our buffer and offset. Read the data.
-    theErr = fInputStream.Read(theRequestBody + theBufferOffset,
-                               content_length - theBufferOffset,
-                               &theLen);
-    Assert(theErr != CF_BadArgument);
+  StrPtrLen *theEncoding = fRequest->GetHeaderValue(httpTransferEncodingHeader);
+  StrPtrLen *theLength = fRequest->GetHeaderValue(httpContentLengthHeader);
 
-    if (theErr == CF_RequestFailed) {
-      // NEED TO RETURN HTTP ERROR RESPONSE
-      return CF_RequestFailed;
+  if (theEncoding != nullptr && theEncoding->Len > 0) {
+    // the body is delimited by the final coding, which must be chunked
+    // (RFC 7230 3.3.3); Content-Length is ignored then
+    StrPtrLen theLast(*theEncoding);
+    for (UInt32 i = theEncoding->Len; i > 0; i--) {
+      if (theEncoding->Ptr[i - 1] == ',') {
+        theLast.Set(theEncoding->Ptr + i, theEncoding->Len - i);
+        break;
+      }
+    }
+    while (theLast.Len > 0 && (theLast.Ptr[0] == ' ' || theLast.Ptr[0] == '\t')) {
+      theLast.Ptr++;
+      theLast.Len--;
+    }
+    if (!theLast.EqualIgnoreCase("chunked", 7)) {
+      fResponse->SetStatusCode(httpBadRequest);
+      return CF_BadArgument;
     }
 
-    // Update our offset in the buffer
-    requestBody->Len = theBufferOffset + theLen;
+    fBodyType = kBodyChunked;
+    fChunkedDecoder.Reset();
+  } else if (theLength != nullptr && theLength->Len > 0) {
+    // digits only, a bogus length can't be skipped
+    UInt64 theValue = 0;
+    bool isValid = theLength->Len <= 19;
+    for (UInt32 i = 0; isValid && i < theLength->Len; i++) {
+      char theChar = theLength->Ptr[i];
+      isValid = theChar >= '0' && theChar <= '9';
+      theValue = theValue * 10 + (theChar - '0');
+    }
+    if (!isValid) {
+      fResponse->SetStatusCode(httpBadRequest);
+      return CF_BadArgument;
+    }
 
-    s_printf("Add Len:%d \n", theLen);
-    if ((theErr == CF_WouldBlock) ||
-        (theLen < (content_length - theBufferOffset))) {
+    if (theValue > 0) {
+      fBodyType = kBodyLength;
+      fBodyRemaining = theValue;
+    }
+  }
 
-      // The entire content body hasn't arrived yet.
-      // Request a read event and wait for it.
+  if (fBodyType == kBodyNone)
+    return CF_NoErr;
 
-      return CF_WouldBlock;
-    }
+  HTTPPathMapper *theMapper = sDispatcher->Match(*fRequest);
+  fBodyMapper = (theMapper != nullptr && theMapper->HasBodyHandler()) ? theMapper : nullptr;
 
-    Assert(theErr == CF_NoErr);
+  // refuse before the client sends the body, or is told to
+  if (fBodyMapper == nullptr && fBodyType == kBodyLength
+      && fBodyRemaining > sMaxRequestBodySize) {
+    fResponse->SetStatusCode(httpRequestEntityTooLarge);
+    return CF_BadArgument;
   }
 
-  s_printf("get complete http msg:%s QueryString:%s \n",
-           fRequest->GetRequestPath(),
-           fRequest->GetQueryString());
+  StrPtrLen *theExpect = fRequest->GetHeaderValue(httpExpectHeader);
+  if (theExpect != nullptr && theExpect->Len > 0
+      && fRequest->GetVersion() == http11Version) {
+    if (!theExpect->EqualIgnoreCase("100-continue", 12)) {
+      fResponse->SetStatusCode(httpExpectationFailed);
+      return CF_BadArgument;
+    }
+
+    // goes out after the responses to earlier pipelined requests; if the
+    // Socket is full the rest is flushed while waiting for the body
+    fOutputStream.Put("HTTP/1.1 100 Continue\r\n\r\n");
+    (void) fOutputStream.Flush();
+  }
 
   return CF_NoErr;
 }
 
+CF_Error HTTPSession::readRequestBody() {
+  char theChunkBuffer[kBodyChunkSize];
+
+  while (true) {
+    char *theDest = theChunkBuffer;
+    UInt32 theRoom = kBodyChunkSize;
+
+    if (fBodyMapper == nullptr) {
+      if (fBodyLength == fBodyCapacity && fBodyCapacity < sMaxRequestBodySize) {
+        UInt64 theNewCapacity = fBodyCapacity > 0 ? (UInt64) fBodyCapacity * 2 : (UInt64) kBodyChunkSize;
+        if (fBodyType == kBodyLength && theNewCapacity > fBodyLength + fBodyRemaining)
+          theNewCapacity = fBodyLength + fBodyRemaining;
+        if (theNewCapacity > sMaxRequestBodySize)
+          theNewCapacity = sMaxRequestBodySize;
+
+        auto *theNewBuffer = new char[theNewCapacity + 1];
+        if (fBodyLength > 0)
+          ::memcpy(theNewBuffer, fBodyBuffer, fBodyLength);
+        delete[] fBodyBuffer;
+        fBodyBuffer = theNewBuffer;
+        fBodyCapacity = (UInt32) theNewCapacity;
+      }
+
+      // a full buffer still reads the chunked framing into theChunkBuffer,
+      // more data is over the limit
+      if (fBodyLength < fBodyCapacity) {
+        theDest = fBodyBuffer + fBodyLength;
+        theRoom = fBodyCapacity - fBodyLength;
+      }
+    }
+
+    // never read past the body, a pipelined request may follow it
+    UInt64 theWanted = fBodyType == kBodyLength
+                       ? fBodyRemaining : fChunkedDecoder.GetMinRemaining();
+    if (theRoom > theWanted)
+      theRoom = (UInt32) theWanted;
+
+    UInt32 theLen = 0;
+    CF_Error theErr = fInputStream.Read(theDest, theRoom, &theLen);
+    if (theLen == 0)
+      return theErr == EAGAIN ? CF_WouldBlock : CF_RequestFailed;
+
+    UInt32 theDataLen = theLen;
+    if (fBodyType == kBodyChunked) {
+      UInt32 theConsumed = 0;
+      if (fChunkedDecoder.Decode(theDest, theLen, &theConsumed, &theDataLen) != CF_NoErr) {
+        fResponse->SetStatusCode(httpBadRequest);
+        return CF_BadArgument;
+      }
+      Assert(theConsumed == theLen);
+    } else {
+      fBodyRemaining -= theLen;
+    }
+
+    bool isLast = fBodyType == kBodyChunked
+                  ? fChunkedDecoder.IsDone() : fBodyRemaining == 0;
+
+    if (fBodyMapper != nullptr) {
+      // the next piece is read only after the handler is done with this one
+      if (theDataLen > 0 || isLast) {
+        StrPtrLen theData(theDest, theDataLen);
+        if (fBodyMapper->MappingBody(*fRequest, theData, isLast) != CF_NoErr) {
+          fBodyMapper = nullptr; // it gave up, not told again
+          fResponse->SetStatusCode(httpInternalServerError);
+          return CF_BadArgument;
+        }
+      }
+      if (isLast)
+        fBodyMapper = nullptr;
+    } else {
+      if ((UInt64) fBodyLength + theDataLen > sMaxRequestBodySize) {
+        fResponse->SetStatusCode(httpRequestEntityTooLarge);
+        return CF_BadArgument;
+      }
+      fBodyLength += theDataLen;
+
+      if (isLast) {
+        fBodyBuffer[fBodyLength] = '\0';
+        fRequest->SetBody(new StrPtrLenDel(fBodyBuffer, fBodyLength));
+        fBodyBuffer = nullptr;
+        fBodyLength = fBodyCapacity = 0;
+      }
+    }
+
+    if (isLast)
+      return CF_NoErr;
+
+    // a short read drained the Socket, wait for the next read event
+    if (theLen < theRoom)
+      return CF_WouldBlock;
+  }
+}
+
 CF_Error HTTPSession::SetupResponse() {
   if (fResponse->GetVersion() == httpIllegalVersion) {
     HTTPVersion requestVersion = fRequest->GetVersion();
@@ -387,7 +693,21 @@ CF_Error HTTPSession::SetupResponse() {
   fResponse->CreateResponseHeader();
 
   StrPtrLen *respBody = fResponse->GetBody();
-  if (respBody != NULL && respBody->Len > 0)
+  fResponseChunked = false;
+  fResponseRemaining = -1;
+
+  if (fResponse->GetBodyStream() != nullptr) {
+    fResponseRemaining = fResponse->GetBodyStreamLength();
+    if (fResponseRemaining >= 0) {
+      fResponse->AppendContentLengthHeader((UInt64) fResponseRemaining);
+    } else if (fResponse->GetVersion() == http11Version) {
+      fResponseChunked = true;
+      fResponse->AppendTransferEncodingChunkedHeader();
+    } else {
+      // HTTP/1.0 has no chunked coding, the body ends with the connection
+      fRequest->SetKeepAlive(false);
+    }
+  } else if (respBody != NULL && respBody->Len > 0)
     fResponse->AppendContentLengthHeader(respBody->Len);
   else
     fResponse->AppendContentLengthHeader((UInt32) 0);
@@ -396,22 +716,97 @@ CF_Error HTTPSession::SetupResponse() {
     fResponse->AppendConnectionCloseHeader();
   }
 
-  char respHeader[2048] = {0};
-  StrPtrLen *ackPtr = fResponse->GetCompleteHTTPHeader();
-  strncpy(respHeader, ackPtr->Ptr, ackPtr->Len);
-
-  fOutputStream.Put(respHeader);
+  fOutputStream.Put(*fResponse->GetCompleteHTTPHeader());
 
   // construct response body
-  if (respBody != NULL && respBody->Len > 0)
+  if (fResponse->GetBodyStream() == nullptr && respBody != NULL && respBody->Len > 0)
     fOutputStream.Put(*respBody);
 
   return CF_NoErr;
 }
 
+void HTTPSession::setCGIStatus(CF_Error inCGIErr) {
+  if (inCGIErr == CF_FileNotFound) {
+    fResponse->SetStatusCode(httpNotFound);
+  } else if (inCGIErr != CF_NoErr) {
+    fResponse->SetStatusCode(httpInternalServerError);
+  }
+}
+
+CF_Error HTTPSession::sendResponseBody() {
+  HTTPBodyStream *theStream = fResponse->GetBodyStream();
+  theStream->fTask = this;
+  char theBuffer[kBodyChunkSize];
+  CF_Error theErr;
+
+  while (true) {
+    // produce no faster than the client takes it
+    if (fOutputStream.GetUnsentLength() >= kBodyChunkSize) {
+      theErr = fOutputStream.Flush();
+      if (theErr != CF_NoErr)
+        return theErr;
+    }
+
+    UInt32 theRoom = kBodyChunkSize;
+    if (fResponseRemaining >= 0 && fResponseRemaining < theRoom)
+      theRoom = (UInt32) fResponseRemaining;
+
+    UInt32 theLen = 0;
+    theErr = theRoom > 0 ? theStream->Read(theBuffer, theRoom, &theLen) : CF_NoMoreData;
+
+    if (theErr == CF_WouldBlock) {
+      // send what there is while waiting
+      theErr = fOutputStream.Flush();
+      return theErr == CF_NoErr ? CF_WouldBlock : theErr;
+    }
+
+    if (theErr == CF_NoMoreData) {
+      if (fResponseChunked)
+        fOutputStream.Put("0\r\n\r\n");
+      else if (fResponseRemaining > 0)
+        fRequest->SetKeepAlive(false); // shorter than announced
+      break;
+    }
+
+    if (theErr != CF_NoErr) {
+      // the status is out already, cut the body off: no last chunk, the
+      // connection is closed
+      fRequest->SetKeepAlive(false);
+      break;
+    }
+
+    if (theLen == 0)
+      continue;
+
+    if (fResponseChunked) {
+      char theChunkSize[16];
+      s_snprintf(theChunkSize, sizeof(theChunkSize), "%x\r\n", theLen);
+      fOutputStream.Put(theChunkSize);
+      fOutputStream.Put(theBuffer, theLen);
+      fOutputStream.PutEOL();
+    } else {
+      fOutputStream.Put(theBuffer, theLen);
+      if (fResponseRemaining > 0)
+        fResponseRemaining -= theLen;
+    }
+  }
+
+  // done, the rest is sent like any other response
+  this->CancelTimeout();
+  fResponse->SetBodyStream(nullptr);
+  return CF_NoErr;
+}
+
 void HTTPSession::CleanupRequestAndResponse() {
 
   if (fRequest != nullptr) {
+    // the body handler is still waiting for the rest of the body
+    if (fBodyMapper != nullptr) {
+      StrPtrLen theNone;
+      (void) fBodyMapper->MappingBody(*fRequest, theNone, true, true);
+      fBodyMapper = nullptr;
+    }
+
     if (!fRequest->IsRequestKeepAlive())
       this->Signal(Thread::Task::kKillEvent);
 
@@ -425,6 +820,13 @@ void HTTPSession::CleanupRequestAndResponse() {
     fResponse = nullptr;
   }
 
+  delete[] fBodyBuffer;
+  fBodyBuffer = nullptr;
+  fBodyLength = fBodyCapacity = 0;
+  fBodyType = kBodyNone;
+  fBodyRemaining = 0;
+  fBodyMapper = nullptr;
+
   fSessionMutex.Unlock();
   fReadMutex.Unlock();
 
@@ -433,11 +835,6 @@ void HTTPSession::CleanupRequestAndResponse() {
   this->SetRequestBodyLength(-1);
 }
 
-bool HTTPSession::OverMaxConnections(UInt32 buffer) {
-
-  return false;
-}
-
 CF_Error HTTPSession::dumpRequestData() {
   char theDumpBuffer[CF_MAX_REQUEST_BUFFER_SIZE];
 
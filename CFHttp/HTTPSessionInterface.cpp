@@ -40,6 +40,9 @@ namespace CF {
 namespace Net {
 
 std::atomic_uint HTTPSessionInterface::sSessionIndexCounter{kFirstHTTPSessionID};
+std::atomic_uint HTTPSessionInterface::sNumSessions{0};
+UInt32 HTTPSessionInterface::sMaxRequestBodySize = kDefaultMaxRequestBodySize;
+UInt32 HTTPSessionInterface::sCGITimeoutInMsec = kDefaultCGITimeoutInMsec;
 
 HTTPDispatcher *HTTPSessionInterface::sDispatcher = nullptr;
 
@@ -49,12 +52,12 @@ void HTTPSessionInterface::Initialize(HTTPMapping *mapping) {
 }
 
 HTTPSessionInterface::HTTPSessionInterface()
-    : Task(),
+    : IdleTask(),
       fTimeoutTask(nullptr, 30 * 1000),
       fInputStream(&fSocket),
       fOutputStream(&fSocket, &fTimeoutTask),
       fSessionMutex(),
-      fSocket(nullptr, Socket::kNonBlockingSocketType),
+      fSocket(nullptr, Socket::kNonBlockingSocketType | Socket::kEdgeTriggeredSocketMode),
       fOutputSocketP(&fSocket),
       fInputSocketP(&fSocket),
       fLiveSession(true),
@@ -67,12 +70,15 @@ HTTPSessionInterface::HTTPSessionInterface()
 
   //fSessionIndex = (UInt32)atomic_add(&sSessionIndexCounter, 1);
   fSessionIndex = ++sSessionIndexCounter;
+  ++sNumSessions;
 
   fInputStream.ShowRTSP(true);
   fOutputStream.ShowRTSP(true);
 }
 
 HTTPSessionInterface::~HTTPSessionInterface() {
+  --sNumSessions;
+
   // If the input Socket is != output Socket, the input Socket was created dynamically
   if (fInputSocketP != fOutputSocketP)
     delete fInputSocketP;
@@ -0,0 +1,79 @@
+/**
+ * @file HTTPChunkedDecoder.h
+ *
+ * Transfer-Encoding: chunked 的解码器。
+ *
+ * 可续传：数据可以从任意位置切开分多次交给 Decode，状态保留到下一次调用。
+ * 解码在原地进行，去掉分块的格式后负载被移到数据的前部，不需要额外的缓冲区。
+ * 请求体和响应体都可以使用。
+ */
+
+#ifndef __HTTP_CHUNKED_DECODER_H__
+#define __HTTP_CHUNKED_DECODER_H__
+
+#include <CF/CFDef.h>
+
+namespace CF {
+namespace Net {
+
+class HTTPChunkedDecoder {
+ public:
+
+  HTTPChunkedDecoder() { this->Reset(); }
+
+  void Reset();
+
+  /**
+   * @brief 解码一段数据
+   *
+   * The payload in ioData is moved to its front.
+   *
+   * @param outConsumed - the bytes of ioData that belong to the chunked body,
+   *                      less than inLength only when the body has ended
+   * @param outDecoded  - the payload bytes now at the front of ioData
+   * @return CF_NoErr, or CF_BadArgument if the framing is broken
+   */
+  CF_Error Decode(char *ioData, UInt32 inLength, UInt32 *outConsumed, UInt32 *outDecoded);
+
+  // The last chunk and the trailer have been decoded
+  bool IsDone() { return fState == kDone; }
+
+  /**
+   * The least number of encoded bytes still to come. Reading no more than
+   * this never reads past the end of the body, so whatever follows it, a
+   * pipelined request for example, stays in the stream.
+   */
+  UInt32 GetMinRemaining();
+
+  UInt64 GetDecodedLength() { return fDecodedLength; }
+
+ private:
+
+  enum {
+    kSize = 0,        // the hex digits of a chunk size
+    kExtension = 1,   // ";name=value" after the size, ignored
+    kSizeLF = 2,
+    kData = 3,
+    kDataCR = 4,      // the CRLF after the data
+    kDataLF = 5,
+    kTrailer = 6,     // the start of a trailer line, or the final CRLF
+    kTrailerLine = 7,
+    kEndLF = 8,
+    kDone = 9,
+    kError = 10
+  };
+
+  // sizes beyond this are refused
+  static const UInt64 kMaxChunkSize = ((UInt64) 1) << 48;
+
+  UInt32 fState;
+  UInt32 fSizeDigits;
+  UInt64 fSize;         // of the current chunk
+  UInt64 fRemaining;    // of the current chunk's data
+  UInt64 fDecodedLength;
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __HTTP_CHUNKED_DECODER_H__
@@ -0,0 +1,73 @@
+/**
+ * @file HTTPCompletion.h
+ *
+ * 异步 CGI 的完成通知。
+ *
+ * 异步 CGI 返回 CF_WouldBlock 表示请求尚未处理完，HTTPSession 不占用
+ * TaskThread 等待；CGI 在任意线程处理完毕后调用 Complete，Session 被
+ * Signal 唤醒后继续发送响应。请求有截止时间，超时后 Session 以 504 响应
+ * 并关闭连接，request/response 仍归 CGI 使用，直到它调用 Complete。
+ */
+
+#ifndef __HTTP_COMPLETION_H__
+#define __HTTP_COMPLETION_H__
+
+#include <atomic>
+#include <CF/Core/Mutex.h>
+#include <CF/Thread/Task.h>
+#include <CF/Net/Http/HTTPPacket.h>
+
+namespace CF {
+namespace Net {
+
+class HTTPCompletion {
+ public:
+
+  /**
+   * @brief 结束异步处理，可在任意线程调用，每个请求必须且只能调用一次
+   *
+   * 调用之后不能再使用 completion、request 和 response。
+   *
+   * @param inErr - CF_NoErr 发送 response；CF_FileNotFound 以 404 响应，
+   *                其他错误以 500 响应
+   */
+  void Complete(CF_Error inErr = CF_NoErr);
+
+  // Changes this request's deadline, only before the CGI returns CF_WouldBlock
+  void SetTimeout(UInt32 inTimeoutInMsec) { fTimeoutInMsec = inTimeoutInMsec; }
+
+  UInt32 GetTimeout() { return fTimeoutInMsec; }
+
+ private:
+
+  HTTPCompletion(Thread::Task *inTask, UInt32 inTimeoutInMsec);
+  ~HTTPCompletion();
+
+  // true once Complete was called, outErr gets its argument
+  bool IsCompleted(CF_Error *outErr);
+
+  /**
+   * The session gives up waiting. The packets go with the completion and
+   * are deleted when the CGI completes, false if that already happened.
+   */
+  bool Detach(HTTPPacket *inRequest, HTTPPacket *inResponse);
+
+  // the session and the CGI each hold a reference
+  void Release();
+
+  Core::Mutex fMutex;
+  Thread::Task *fTask;
+  HTTPPacket *fRequest;     // detached, see Detach
+  HTTPPacket *fResponse;
+  UInt32 fTimeoutInMsec;
+  CF_Error fResult;
+  bool fCompleted;
+  std::atomic_int fRefCount;
+
+  friend class HTTPSession;
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __HTTP_COMPLETION_H__
@@ -27,6 +27,13 @@ class HTTPConfigure {
     CF_NetAddr *httpListenAddrs = config->GetHttpListenAddr(&numHttpListens);
     if (numHttpListens > 0) {
       HTTPSessionInterface::Initialize(config->GetHttpMapping());
+      HTTPListenerSocket::SetAdmissionLimits(config->GetHttpMaxConnections(),
+                                             config->GetHttpMaxTaskQueueLength(),
+                                             config->GetHttpMaxEventLagUSec());
+      HTTPRequestStream::SetHeaderLimits(config->GetHttpMaxHeaderSize(),
+                                         config->GetHttpMaxHeaderFields());
+      HTTPSessionInterface::SetMaxRequestBodySize(config->GetHttpMaxRequestBodySize());
+      HTTPSessionInterface::SetCGITimeout(config->GetHttpCGITimeout());
       for (UInt32 i = 0; i < numHttpListens; i++) {
         auto *httpSocket = new HTTPListenerSocket();
         theErr = httpSocket->Initialize(SocketUtils::ConvertStringToAddr(httpListenAddrs[i].ip), httpListenAddrs[i].port);
@@ -57,8 +64,8 @@ class HTTPConfigure {
 
   virtual HTTPMapping *GetHttpMapping() {
     static HTTPMapping defaultHttpMapping[] = {
-        {"/exit", (CF_CGIFunction) DefaultExitCGI},
-        {NULL, NULL}
+        {"/exit", (CF_CGIFunction) DefaultExitCGI, nullptr, nullptr},
+        {NULL, NULL, NULL, NULL}
     };
     return defaultHttpMapping;
   }
@@ -71,6 +78,31 @@ class HTTPConfigure {
     return defaultHttpAddrs;
   }
 
+  //
+  // Admission control, 0 means no limit. Connections over a limit are
+  // answered with 503 and accepting is paused until the load drops.
+
+  virtual UInt32 GetHttpMaxConnections() { return 0; }
+  virtual UInt32 GetHttpMaxTaskQueueLength() { return 0; }
+  virtual UInt32 GetHttpMaxEventLagUSec() { return 0; }
+
+  //
+  // Request header limits. Larger headers, or more fields, are answered
+  // with 400 and the connection is closed.
+
+  virtual UInt32 GetHttpMaxHeaderSize() { return HTTPRequestStream::kDefaultMaxHeaderSize; }
+  virtual UInt32 GetHttpMaxHeaderFields() { return HTTPRequestStream::kDefaultMaxHeaderFields; }
+
+  // Request bodies buffered for a CGI, larger ones are answered with 413.
+  // Mappings with a body handler stream the body and have no limit.
+
+  virtual UInt32 GetHttpMaxRequestBodySize() { return HTTPSessionInterface::kDefaultMaxRequestBodySize; }
+
+  // Async CGIs not completed within this are answered with 504 and the
+  // connection is closed.
+
+  virtual UInt32 GetHttpCGITimeout() { return HTTPSessionInterface::kDefaultCGITimeoutInMsec; }
+
 };
 
 }
@@ -6,6 +6,7 @@
 #define __CF_HTTP_DEF_H__
 
 #include <CF/Net/Http/HTTPPacket.h>
+#include <CF/Net/Http/HTTPCompletion.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,9 +15,33 @@ extern "C" {
 typedef CF_Error (*CF_CGIFunction) (CF::Net::HTTPPacket &request,
                                     CF::Net::HTTPPacket &response);
 
+/**
+ * 请求体的流式处理函数，请求体每到达一段就调用一次，last 表示最后一段。
+ * 设置了此函数的映射，请求体不再缓存到 request 中，也不受大小限制；
+ * 请求体结束后再调用 func 生成响应。返回错误则以 500 响应并关闭连接，
+ * 之后不再调用。
+ * 请求体未读完就中止时(400、连接断开等)，最后以 data 为空、last 和 aborted
+ * 为 true 调用一次。每次上传的状态可以保存在 request.SetContext 中。
+ */
+typedef CF_Error (*CF_CGIBodyFunction) (CF::Net::HTTPPacket &request,
+                                        CF::StrPtrLen &data,
+                                        bool last,
+                                        bool aborted);
+
+/**
+ * 异步 CGI，不在 TaskThread 上等待下游的结果。
+ * 返回 CF_WouldBlock 表示稍后(可在任意线程)调用 completion->Complete 结束
+ * 处理；返回其他值则与 CF_CGIFunction 相同，此时不能再使用 completion。
+ */
+typedef CF_Error (*CF_CGIAsyncFunction) (CF::Net::HTTPPacket &request,
+                                         CF::Net::HTTPPacket &response,
+                                         CF::Net::HTTPCompletion *completion);
+
 struct HTTPMapping {
   char *path;
   CF_CGIFunction func;
+  CF_CGIBodyFunction body;    // optional
+  CF_CGIAsyncFunction async;  // optional, used instead of func
 };
 typedef struct HTTPMapping HTTPMapping;
 
@@ -7,6 +7,7 @@
 
 #include <CF/Net/Http/HTTPDef.h>
 #include <CF/Net/Http/HTTPPacket.h>
+#include <CF/Net/Http/HTTPRouter.h>
 
 namespace CF {
 namespace Net {
@@ -22,9 +23,14 @@ class HTTPDispatcher {
 
   CF_Error Dispatch(HTTPPacket &request, HTTPPacket &response);
 
+  // The mapper for the request, nullptr if none matches. The path
+  // parameters of the route are stored in the request.
+  HTTPPathMapper *Match(HTTPPacket &request);
+
  private:
   HTTPPathMapper **fMappers;
   UInt32 fMapperNum;
+  HTTPRouter fRouter;
 };
 
 class HTTPPathMapper {
@@ -39,8 +45,6 @@ class HTTPPathMapper {
 
   static HTTPPathMapper *BuildPathMatcher(HTTPMapping &mapping);
 
-  static int ComparePriority(HTTPPathMapper *aMapper, HTTPPathMapper *bMapper);
-
   virtual ~HTTPPathMapper() = default;;
 
   virtual UInt32 ItsType() = 0;
@@ -51,10 +55,27 @@ class HTTPPathMapper {
     return fFunc(request, response);
   }
 
+  bool HasBodyHandler() { return fBodyFunc != nullptr; }
+
+  bool IsAsync() { return fAsyncFunc != nullptr; }
+
+  CF_Error MappingAsync(HTTPPacket &request, HTTPPacket &response,
+                        HTTPCompletion *completion) {
+    return fAsyncFunc(request, response, completion);
+  }
+
+  CF_Error MappingBody(HTTPPacket &request, StrPtrLen &data, bool last,
+                       bool aborted = false) {
+    return fBodyFunc(request, data, last, aborted);
+  }
+
  protected:
-  HTTPPathMapper(HTTPMapping mapping) : fFunc(mapping.func) {}
+  HTTPPathMapper(HTTPMapping mapping)
+      : fFunc(mapping.func), fBodyFunc(mapping.body), fAsyncFunc(mapping.async) {}
 
   CF_CGIFunction fFunc;
+  CF_CGIBodyFunction fBodyFunc;
+  CF_CGIAsyncFunction fAsyncFunc;
 
   static StrPtrLen sAllSuffix;
   static StrPtrLen sTypePrefix;
@@ -0,0 +1,125 @@
+/**
+ * @file HTTPHeaderParser.h
+ *
+ * 可续传的 HTTP 报文头解析器。
+ *
+ * 报文头分多次到达时，每次只扫描新到的数据，解析状态保留到下一次调用，
+ * 不会从头重新扫描。扫描的同时记录起始行和各个字段名/值的偏移，报文头
+ * 完整后 HTTPPacket 直接使用这些结果，不必再解析一遍。
+ */
+
+#ifndef __HTTP_HEADER_PARSER_H__
+#define __HTTP_HEADER_PARSER_H__
+
+#include <CF/CFDef.h>
+#include <CF/StrPtrLen.h>
+
+namespace CF {
+namespace Net {
+
+class HTTPHeaderParser {
+ public:
+
+  enum {
+    kDefaultMaxFields = 100   //UInt32, more fields make the header malformed
+  };
+
+  // Offsets are relative to the start of the data given to Parse
+  struct Field {
+    UInt32 fNameOffset;
+    UInt32 fNameLen;
+    UInt32 fValueOffset;  // leading and trailing whitespace is trimmed
+    UInt32 fValueLen;
+  };
+
+  /**
+   * @param inMaxFields - 0 records no fields, the parser only finds the end
+   *                      of the header then (and calls it malformed)
+   */
+  explicit HTTPHeaderParser(UInt32 inMaxFields = kDefaultMaxFields)
+      : fMaxFields(inMaxFields), fFieldsSize(0), fFields(nullptr) { this->Reset(); }
+
+  ~HTTPHeaderParser() { delete[] fFields; }
+
+  void SetMaxFields(UInt32 inMaxFields) { fMaxFields = inMaxFields; }
+
+  // Starts over with a new header
+  void Reset();
+
+  // Reset, and frees the field table until the next header needs it
+  void Release();
+
+  /**
+   * @brief 继续解析报文头
+   *
+   * inData must hold the same bytes as in the previous calls, followed by
+   * the new ones; it may have moved. Less data than before starts over.
+   *
+   * The legal end-of-header sequences are \r\r, \r\n\r\n & \n\n. A first
+   * line without blanks (a ShoutCast password) is a complete header too.
+   *
+   * @return true if the header is complete
+   */
+  bool Parse(char const *inData, UInt32 inLength);
+
+  bool IsComplete() { return fState == kDone; }
+
+  // A field line without a colon, a folded line, or too many fields. The
+  // header is still scanned to its end, so the next request can be found.
+  bool IsMalformed() { return fMalformed; }
+
+  // The header including the final empty line, valid when complete
+  UInt32 GetHeaderLength() { return fOffset; }
+
+  // The first line without its EOL; empty lines before it are skipped
+  UInt32 GetStartLineOffset() { return fStartLineOffset; }
+  UInt32 GetStartLineLen() { return fStartLineLen; }
+  // Where the fields begin, i.e. the first line ends here with its EOL
+  UInt32 GetFieldsOffset() { return fFieldsOffset; }
+
+  UInt32 GetNumFields() { return fNumFields; }
+  Field const &GetField(UInt32 inIndex) {
+    Assert(inIndex < fNumFields);
+    return fFields[inIndex];
+  }
+
+ private:
+
+  enum {
+    kLeadingEOL = 0,
+    kStartLine = 1,
+    kFieldLine = 2,
+    kCR = 3,        // a line ended with '\r', is a '\n' next?
+    kDone = 4
+  };
+
+  void endLine(char const *inData, bool inLoneCR);
+  void addField(char const *inData, UInt32 inStart, UInt32 inEnd);
+
+  UInt32 fState;
+  UInt32 fLineState;    // the kind of line that kCR ends
+  UInt32 fOffset;       // everything before has been scanned
+  UInt32 fLineStart;
+  UInt32 fLineEnd;      // where the EOL of the current line starts
+  bool fLoneCR;         // the last line ended with a '\r' only
+  bool fMalformed;
+
+  UInt32 fStartLineOffset;
+  UInt32 fStartLineLen;
+  UInt32 fFieldsOffset;
+
+  // grows on demand, most requests have a few fields
+  enum {
+    kInitialFieldsSize = 16   //UInt32
+  };
+
+  UInt32 fMaxFields;
+  UInt32 fNumFields;
+  UInt32 fFieldsSize;
+  Field *fFields;
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __HTTP_HEADER_PARSER_H__
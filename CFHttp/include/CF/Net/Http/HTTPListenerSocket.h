@@ -17,12 +17,38 @@ class HTTPListenerSocket : public TCPListenerSocket {
 
   ~HTTPListenerSocket() override = default;
 
+  /**
+   * @brief 设置准入控制的阈值，0 表示不限制
+   *
+   * 任一阈值被超过时，新连接会收到 503 并被关闭，listener 暂停 accept，
+   * 直到负载回落。
+   *
+   * @param inMaxConnections - 存活的 HTTP Session 数
+   * @param inMaxQueueLength - 任一 TaskThread 中等待执行的 Task 数
+   * @param inMaxEventLagUSec - EventThread 的分发延迟(平滑值，微秒)
+   */
+  static void SetAdmissionLimits(UInt32 inMaxConnections,
+                                 UInt32 inMaxQueueLength,
+                                 UInt32 inMaxEventLagUSec) {
+    sMaxConnections = inMaxConnections;
+    sMaxQueueLength = inMaxQueueLength;
+    sMaxEventLagUSec = inMaxEventLagUSec;
+  }
+
   //sole job of this object is to implement this function
   Thread::Task *GetSessionTask(TCPSocket **outSocket) override;
 
+  //answer with a canned 503 and close
+  void RejectConnection(int osSocket) override;
+
   //check whether the Listener should be idling
   bool OverMaxConnections(UInt32 buffer);
 
+ private:
+
+  static UInt32 sMaxConnections;
+  static UInt32 sMaxQueueLength;
+  static UInt32 sMaxEventLagUSec;
 };
 
 } // namespace Net
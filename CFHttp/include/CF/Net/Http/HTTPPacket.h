@@ -29,11 +29,83 @@
 #include <CF/StringParser.h>
 #include <CF/ResizeableStringFormatter.h>
 #include <CF/Net/Http/HTTPProtocol.h>
+#include <CF/Net/Http/HTTPHeaderParser.h>
 #include <CF/Net/Http/QueryParamList.h>
+#include <atomic>
 
 namespace CF {
+
+namespace Thread {
+class Task;
+}
+
 namespace Net {
 
+/**
+ * @brief 流式的响应体
+ *
+ * 响应头先发出，响应体由 HTTPSession 在 Socket 可写时分段拉取，不必整个
+ * 生成在内存中。Socket 发送不及时不会再拉取，慢速的客户端不会使数据堆积。
+ */
+class HTTPBodyStream {
+ public:
+  HTTPBodyStream() : fTask(nullptr) {}
+  virtual ~HTTPBodyStream() = default;
+
+  /**
+   * @brief 读取下一段响应体
+   *
+   * @return CF_NoErr       - *outLength bytes were written into ioBuffer
+   *         CF_NoMoreData  - the body is complete
+   *         CF_WouldBlock  - nothing is ready yet, see Wakeup
+   *         other          - the response is cut off and the connection closed
+   */
+  virtual CF_Error Read(char *ioBuffer, UInt32 inLength, UInt32 *outLength) = 0;
+
+  /**
+   * @brief 数据就绪后唤醒 Session 再次 Read，可在任意线程调用
+   *
+   * A stream that answered CF_WouldBlock should call this when it has more;
+   * one that doesn't is only asked again after a long fallback interval.
+   * It must not be called after the stream is deleted.
+   */
+  void Wakeup();
+
+ private:
+  std::atomic<Thread::Task *> fTask;  // the session pulling the stream
+
+  friend class HTTPSession;
+};
+
+/**
+ * 路由中 {name} 参数段匹配到的值，由 HTTPRouter 填写。
+ * 值指向请求行，名称指向路由表，不分配内存。
+ */
+class HTTPPathParams {
+ public:
+  enum {
+    kMaxParams = 8   //UInt32
+  };
+
+  HTTPPathParams() : fNumParams(0) {}
+
+  void Clear() { fNumParams = 0; }
+
+  UInt32 GetNumParams() { return fNumParams; }
+  StrPtrLen *GetName(UInt32 inIndex) { return &fNames[inIndex]; }
+  StrPtrLen *GetValue(UInt32 inIndex) { return &fValues[inIndex]; }
+
+  // nullptr if the matched route has no such parameter
+  StrPtrLen *Get(char const *inName);
+
+ private:
+  UInt32 fNumParams;
+  StrPtrLen fNames[kMaxParams];
+  StrPtrLen fValues[kMaxParams];
+
+  friend class HTTPRouter;
+};
+
 class HTTPPacket {
  public:
 
@@ -41,8 +113,11 @@ class HTTPPacket {
    * @brief construct object for parse http packet header.
    *
    * @param packetPtr - http packet data
+   * @param headerParser - the header already tokenized by the request
+   *                       stream, Parse uses it instead of scanning again.
+   *                       It must stay valid until Parse is called.
    */
-  HTTPPacket(StrPtrLen *packetPtr);
+  HTTPPacket(StrPtrLen *packetPtr, HTTPHeaderParser *headerParser = nullptr);
 
   /**
    * @brief construct object for build http packet
@@ -84,16 +159,46 @@ class HTTPPacket {
 
   char const *GetQueryValues(char *inParam);
 
+  // The {name} segments of the route the request matched
+  HTTPPathParams *GetPathParams() { return &fPathParams; }
+  StrPtrLen *GetPathParam(char const *inName) { return fPathParams.Get(inName); }
+
+  typedef void (*ContextRelease)(void *inContext);
+
+  /**
+   * @brief 请求级的上下文，CGI 在多次回调(如流式请求体)之间保存状态
+   *
+   * @param inRelease - called with the context when it is replaced or the
+   *                    packet is deleted, nullptr if the CGI frees it itself
+   */
+  void SetContext(void *inContext, ContextRelease inRelease = nullptr) {
+    if (fContextRelease != nullptr && fContext != nullptr)
+      fContextRelease(fContext);
+    fContext = inContext;
+    fContextRelease = inRelease;
+  }
+  void *GetContext() { return fContext; }
+
   // If header field exists in the request, it will be found in the dictionary
   // and the value returned. Otherwise, NULL is returned.
   StrPtrLen *GetHeaderValue(HTTPHeader inHeader);
 
+  // Any header by name, nullptr if absent. Of the headers HTTPProtocol
+  // doesn't know, the first kMaxUnknownHeaders are kept.
+  StrPtrLen *GetHeaderValue(const StrPtrLen &inName);
+
+  enum {
+    kMaxUnknownHeaders = 16   //UInt32
+  };
+
   // Creates a header
   bool CreateResponseHeader();
   bool CreateRequestHeader();
 
   void SetVersion(HTTPVersion version) { fVersion = version; }
   void SetStatusCode(HTTPStatusCode statusCode) { fStatusCode = statusCode; }
+  // e.g. the rest of a bad request body can't be skipped, close afterwards
+  void SetKeepAlive(bool keepAlive) { fRequestKeepAlive = keepAlive; }
 
   // To append response header fields as appropriate
   void AppendResponseHeader(HTTPHeader inHeader, StrPtrLen *inValue) const;
@@ -101,6 +206,7 @@ class HTTPPacket {
   void AppendDateField() const;
   void AppendConnectionCloseHeader() const;
   void AppendConnectionKeepAliveHeader() const;
+  void AppendTransferEncodingChunkedHeader() const;
   void AppendContentLengthHeader(UInt64 length_64bit) const;
   void AppendContentLengthHeader(UInt32 length_32bit) const;
 
@@ -124,6 +230,23 @@ class HTTPPacket {
     fHTTPBody = body;
   }
 
+  /**
+   * @brief 设置流式的响应体，代替 SetBody
+   *
+   * @param inLength - the length of the body if known, it is sent with
+   *                   chunked transfer coding (HTTP/1.1) or ends with the
+   *                   connection (HTTP/1.0) otherwise
+   *
+   * @note stream 对象交由 Packet 对象管理
+   */
+  void SetBodyStream(HTTPBodyStream *stream, SInt64 inLength = -1) {
+    delete fBodyStream;
+    fBodyStream = stream;
+    fBodyStreamLength = inLength;
+  }
+  HTTPBodyStream *GetBodyStream() { return fBodyStream; }
+  SInt64 GetBodyStreamLength() { return fBodyStreamLength; }
+
   //
   // Other Utils
 
@@ -143,10 +266,16 @@ class HTTPPacket {
   // Parses the headers and adds them into a dictionary
   // Also calls SetKeepAlive with the Connection header field's value if it exists
   CF_Error parseHeaders(StringParser *parser);
+  // The same, from the fields recorded by fHeaderParser
+  CF_Error parseTokenizedHeader();
 
   // Sets fRequestKeepAlive
   void setKeepAlive(StrPtrLen *keepAliveValue);
 
+  // Records a header HTTPProtocol doesn't know, the last value wins
+  void addUnknownHeader(StrPtrLen &inName, StrPtrLen &inValue);
+  static UInt32 hashUnknownHeader(const StrPtrLen &inName);
+
   //
   // For construct
 
@@ -167,11 +296,14 @@ class HTTPPacket {
 
   // Complete request and response headers
   StrPtrLen fPacketHeader; // for parse
+  HTTPHeaderParser *fHeaderParser; // for parse, may be nullptr
   ResizeableStringFormatter *fHTTPHeaderFormatter; // for construct
   StrPtrLen *fHTTPHeader; // for construct. it really is StrPtrLenDel
 
   // request and repose body
   StrPtrLen *fHTTPBody;
+  HTTPBodyStream *fBodyStream;  // response only, instead of fHTTPBody
+  SInt64 fBodyStreamLength;     // -1 if unknown
 
   HTTPType fHTTPType;
 
@@ -195,9 +327,23 @@ class HTTPPacket {
   char *fQueryString;
 
   QueryParamList *fQueryValues;
+  HTTPPathParams fPathParams;
+
+  void *fContext;               // see SetContext
+  ContextRelease fContextRelease;
 
   bool fRequestKeepAlive;  // Keep-alive information in the client request
   StrPtrLen fFieldValues[httpNumHeaders]; // Array of header field values parsed from the request
+
+  // The other headers, in the order they arrived, open-addressed by name:
+  // a slot holds the index + 1, 0 is empty
+  enum {
+    kUnknownHeaderSlots = 2 * kMaxUnknownHeaders   //UInt32, a power of 2
+  };
+  UInt32 fNumUnknownHeaders;
+  StrPtrLen fUnknownNames[kMaxUnknownHeaders];
+  StrPtrLen fUnknownValues[kMaxUnknownHeaders];
+  UInt8 fUnknownSlots[kUnknownHeaderSlots];
   StrPtrLen fSvrHeader;  // Server header set up at initialization
 
   static StrPtrLen sColonSpace;
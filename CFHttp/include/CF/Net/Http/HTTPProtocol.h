@@ -228,6 +228,17 @@ class HTTPProtocol {
   static const StrPtrLen sVersionStrings[];
 
   static const StrPtrLen sStreamTypes[];
+
+  // GetHeader looks the name up in sHeaderSlots, see HTTPProtocol.cpp
+  enum {
+    kHeaderSlots = 128   //UInt32, a power of 2, over twice httpNumHeaders
+  };
+
+  static UInt32 hashHeader(char const *inName, UInt32 inLen);
+  static bool buildHeaderSlots();
+
+  static UInt8 sHeaderSlots[kHeaderSlots];
+  static bool sHeaderSlotsBuilt;
 };
 
 } // namespace Net
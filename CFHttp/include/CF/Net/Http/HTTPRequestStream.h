@@ -39,6 +39,7 @@
 //INCLUDES
 #include <CF/CFDef.h>
 #include <CF/Net/Socket/TCPSocket.h>
+#include <CF/Net/Http/HTTPHeaderParser.h>
 
 namespace CF {
 namespace Net {
@@ -50,11 +51,21 @@ class HTTPRequestStream {
 
   explicit HTTPRequestStream(TCPSocket *sock);
 
-  // We may have to delete this memory if it was allocated due to base64 decoding
-  ~HTTPRequestStream() {
-    if (fRequest.Ptr != &fRequestBuffer[0])
-      delete[] fRequest.Ptr;
-  }
+  ~HTTPRequestStream();
+
+  enum {
+    kDefaultMaxHeaderSize = 16 * 1024,   //UInt32
+    kDefaultMaxHeaderFields = HTTPHeaderParser::kDefaultMaxFields   //UInt32
+  };
+
+  /**
+   * @brief 设置请求头的限制，对之后创建的 stream 生效
+   *
+   * The header buffer starts at CF_MAX_REQUEST_BUFFER_SIZE and doubles up to
+   * inMaxHeaderSize, a larger header makes ReadRequest return E2BIG. More
+   * than inMaxHeaderFields fields make the header malformed.
+   */
+  static void SetHeaderLimits(UInt32 inMaxHeaderSize, UInt32 inMaxHeaderFields);
 
   /**
    * @brief ReadRequest - read request header
@@ -68,7 +79,7 @@ class HTTPRequestStream {
    * @return CF_RequestArrived - full request has arrived
    * @return CF_RequestFailed  - if the client has disconnected
    * @return CF_OutOfState
-   * @return E2BIG             - ran out of buffer space
+   * @return E2BIG             - the header is larger than the limit
    * @return EINVAL            - if we are base64 decoding and the stream is corrupt
    */
   CF_Error ReadRequest();
@@ -102,8 +113,26 @@ class HTTPRequestStream {
    */
   StrPtrLen *GetRequestBuffer() { return fRequestPtr; }
 
+  /**
+   * The header as tokenized while it was read, offsets are relative to
+   * GetRequestBuffer()->Ptr. NULL unless a complete request header (not a
+   * data packet) has arrived. Valid until the next ReadRequest.
+   */
+  HTTPHeaderParser *GetHeaderParser() {
+    if (fRequestPtr == NULL || fIsDataPacket || !fHeaderParser.IsComplete())
+      return NULL;
+    return &fHeaderParser;
+  }
+
   bool IsDataPacket() { return fIsDataPacket; }
 
+  /**
+   * Whether the retreat bytes already hold another complete request header,
+   * i.e. the client is pipelining and the next ReadRequest won't touch the
+   * Socket. Only meaningful once the current request's body has been read.
+   */
+  bool HasBufferedRequest();
+
   void ShowRTSP(bool enable) { fPrintRTSP = enable; }
 
   void SnarfRetreat(HTTPRequestStream &fromRequest);
@@ -112,9 +141,17 @@ class HTTPRequestStream {
 
   //CONSTANTS:
   enum {
+    // the first buffer, it doesn't grow while base64 decoding
     kRequestBufferSizeInBytes = CF_MAX_REQUEST_BUFFER_SIZE        //UInt32
   };
 
+  // Makes the buffer hold at least inMinSize bytes, keeps fCurOffset bytes
+  void growBuffer(UInt32 inMinSize);
+  // Gives the buffer back to the pool while the connection is idle
+  void releaseBuffer();
+  // How far the buffer may be filled now
+  UInt32 bufferLimit();
+
   // Base64 decodes into fRequest.Ptr, updates fRequest.Len, and returns the amount
   // of data left undecoded in inSrcData
   CF_Error DecodeIncomingData(char *inSrcData, UInt32 inSrcDataLen);
@@ -123,17 +160,21 @@ class HTTPRequestStream {
   UInt32 fRetreatBytes;
   UInt32 fRetreatBytesRead; // Used by Read() when it is reading RetreatBytes
 
-  char fRequestBuffer[kRequestBufferSizeInBytes];
+  char *fRequestBuffer; // from the pool, NULL while idle
+  UInt32 fRequestBufferSize;
   UInt32 fCurOffset; // tracks how much valid data is in the above buffer
   UInt32
       fEncodedBytesRemaining; // If we are decoding, tracks how many encoded bytes are in the buffer
 
   StrPtrLen fRequest;
   StrPtrLen *fRequestPtr;    // pointer to a request header
+  HTTPHeaderParser fHeaderParser; // resumes the scan for the end of the header
   bool fDecode;        // should we base 64 decode?
   bool fIsDataPacket;  // is this a data packet? Like for a record?
   bool fPrintRTSP;     // debugging printfs
 
+  static UInt32 sMaxHeaderSize;
+  static UInt32 sMaxHeaderFields;
 };
 
 } // namespace Net
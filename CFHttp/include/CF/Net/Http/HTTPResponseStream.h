@@ -89,6 +89,9 @@ class HTTPResponseStream : public ResizeableStringFormatter {
   // this returns QTSS_NoErr, otherwise, it returns EWOULDBLOCK
   CF_Error Flush();
 
+  // The number of buffered bytes that haven't been sent yet
+  UInt32 GetUnsentLength() { return this->GetCurrentOffset() - fBytesSentInBuffer; }
+
   void ShowRTSP(bool enable) { fPrintRTSP = enable; }
 
  private:
@@ -0,0 +1,99 @@
+/**
+ * @file HTTPRouter.h
+ *
+ * HTTPDispatcher 的路由表，启动时由映射表一次构建。
+ *
+ * 精确路由和前缀(/ *)路由放在同一棵按字节压缩的基数树中，扩展名(*.ext)路由
+ * 放在另一棵以反序字节建立的树中，查找的代价只与路径长度有关，与路由数量
+ * 无关，查找过程不分配内存。
+ *
+ * 精确路由的路径中可以含有 {name} 形式的参数段，匹配任意一个非空的路径段，
+ * 匹配到的值保存在 HTTPPathParams 中。
+ */
+
+#ifndef __HTTP_ROUTER_H__
+#define __HTTP_ROUTER_H__
+
+#include <CF/Net/Http/HTTPPacket.h>
+
+namespace CF {
+namespace Net {
+
+class HTTPPathMapper;
+
+class HTTPRouter {
+ public:
+
+  HTTPRouter();
+  ~HTTPRouter() = default;
+
+  /**
+   * @brief 添加一条路由
+   *
+   * The path is classified like HTTPPathMapper::BuildPathMatcher does, the
+   * mapper is not owned by the router. Only exact paths may have parameters.
+   *
+   * @return false if the path is malformed or the route is already taken
+   */
+  bool Add(char const *inPath, HTTPPathMapper *inMapper);
+
+  /**
+   * @brief 查找路由
+   *
+   * 优先级：精确(静态段优先于参数段) > 最长的前缀 > 最长的扩展名 > 默认。
+   *
+   * @param outParams - the parameter values, they point into inPath
+   * @return nullptr if nothing matches
+   */
+  HTTPPathMapper *Match(StrPtrLen &inPath, HTTPPathParams *outParams);
+
+ private:
+
+  class Node {
+   public:
+    Node(char const *inLabel, UInt32 inLen);
+    ~Node();
+
+    Node(const Node &) = delete;
+    Node &operator=(const Node &) = delete;
+
+    Node *findChild(char inByte);
+    void addChild(Node *inChild);
+    // keeps the first inLen bytes of the label, the rest moves to a new child
+    void split(UInt32 inLen);
+
+    char *fLabel;             // the bytes from the parent to here
+    UInt32 fLabelLen;
+    char *fIndices;           // the first byte of each static child
+    Node **fChildren;
+    UInt32 fNumChildren;
+    Node *fParamChild;        // a {name} segment
+    StrPtrLen fParamName;     // if this is a parameter node
+    HTTPPathMapper *fExact;   // a route ends here
+    HTTPPathMapper *fPrefix;  // a prefix route, a suffix in the extension tree
+  };
+
+  // the node the static bytes lead to, created as needed
+  static Node *insertStatic(Node *ioNode, char const *inBytes, UInt32 inLen);
+  // the node the static bytes lead to, nullptr if there is none yet
+  static Node *findStatic(Node *inNode, char const *inBytes, UInt32 inLen);
+
+  static HTTPPathMapper *matchExact(Node *inNode, char const *inPath, UInt32 inLen,
+                                    HTTPPathParams *outParams);
+
+  // the deepest fPrefix on the static path inPath leads along,
+  // read from its end if inReverse
+  static HTTPPathMapper *matchPrefix(Node *inNode, char const *inPath, UInt32 inLen,
+                                     bool inReverse);
+
+  bool addExact(char const *inPath, UInt32 inLen, HTTPPathMapper *inMapper);
+
+  Node fTree;             // exact & prefix routes
+  Node fExtensionTree;    // extension routes, the bytes reversed
+  HTTPPathMapper *fDefault;
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __HTTP_ROUTER_H__
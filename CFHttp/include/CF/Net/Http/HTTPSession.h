@@ -2,6 +2,8 @@
 #define __HTTP_SESSION_H__
 
 #include <CF/Net/Http/HTTPSessionInterface.h>
+#include <CF/Net/Http/HTTPChunkedDecoder.h>
+#include <CF/Net/Http/HTTPCompletion.h>
 
 namespace CF {
 namespace Net {
@@ -25,15 +27,62 @@ class HTTPSession : public HTTPSessionInterface {
   CF_Error SetupResponse();
   void CleanupRequestAndResponse();
 
-  // test current connections handled by this object against server pref connection limit
-  static inline bool OverMaxConnections(UInt32 buffer);
-
   CF_Error dumpRequestData();
 
+  // Checks the body framing of a newly parsed request, answers Expect
+  CF_Error startRequestBody();
+  // Reads what has arrived of the body, streamed to the body handler or
+  // buffered for the CGI
+  CF_Error readRequestBody();
+  // Pulls the response body stream until it ends, the Socket is
+  // flow-controlled (EAGAIN) or the stream has nothing ready (CF_WouldBlock)
+  CF_Error sendResponseBody();
+
+  // The response status for what the CGI returned
+  void setCGIStatus(CF_Error inCGIErr);
+
+  enum {
+    // pipelined responses are held back up to this many bytes, then the batch
+    // is flushed even if more requests are waiting
+    kMaxPipelinedResponseBytes = 64 * 1024,   //UInt32
+
+    // a streamed body is read & handed over in pieces of at most this size
+    kBodyChunkSize = 16 * 1024,               //UInt32
+
+    // a response body stream with nothing ready is asked again after this
+    // unless it wakes the session earlier, see HTTPBodyStream::Wakeup
+    kBodyStreamRetryMSec = 1000               //UInt32
+  };
+
+  enum {
+    kBodyNone = 0,
+    kBodyLength = 1,    // Content-Length
+    kBodyChunked = 2    // Transfer-Encoding: chunked
+  };
+
   HTTPPacket *fRequest;
   HTTPPacket *fResponse;
   Core::Mutex fReadMutex;
 
+  UInt32 fBodyType;
+  UInt64 fBodyRemaining;          // of a Content-Length body
+  HTTPChunkedDecoder fChunkedDecoder;
+  HTTPPathMapper *fBodyMapper;    // streams the body until its last piece
+
+  // the buffered body, handed to fRequest when complete
+  char *fBodyBuffer;
+  UInt32 fBodyLength;
+  UInt32 fBodyCapacity;
+
+  // the response body stream, see SetupResponse
+  bool fResponseChunked;
+  SInt64 fResponseRemaining;      // -1 if the length is unknown
+
+  // the async CGI in progress, after the deadline it may still be running
+  // with the request & response detached from the session
+  HTTPCompletion *fCompletion;
+  SInt64 fCGIDeadline;
+
   enum {
     kReadingRequest = 0,
     kFilteringRequest = 1,
@@ -42,7 +91,9 @@ class HTTPSession : public HTTPSessionInterface {
     kSendingResponse = 4,
     kCleaningUp = 5,
     kReadingFirstRequest = 6,
-    kHaveCompleteMessage = 7
+    kHaveCompleteMessage = 7,
+    kSendingResponseBody = 8,
+    kWaitingForCGI = 9
   } fState;
 };
 
@@ -17,7 +17,7 @@
 namespace CF {
 namespace Net {
 
-class HTTPSessionInterface : public Thread::Task {
+class HTTPSessionInterface : public Thread::IdleTask {
  public:
 
   /**
@@ -35,6 +35,22 @@ class HTTPSessionInterface : public Thread::Task {
   HTTPSessionInterface();
   virtual ~HTTPSessionInterface();
 
+  // number of session objects alive, used for admission control
+  static UInt32 GetNumSessions() { return sNumSessions; }
+
+  enum {
+    kDefaultMaxRequestBodySize = 1024 * 1024,  //UInt32
+    kDefaultCGITimeoutInMsec = 10 * 1000       //UInt32
+  };
+
+  // Request bodies kept in memory for the CGI are limited to this size,
+  // larger ones are answered with 413. Streamed bodies are not limited.
+  static void SetMaxRequestBodySize(UInt32 inSize) { sMaxRequestBodySize = inSize; }
+
+  // Async CGIs that haven't completed after this are answered with 504,
+  // a CGI may change it for its request, see HTTPCompletion
+  static void SetCGITimeout(UInt32 inTimeoutInMsec) { sCGITimeoutInMsec = inTimeoutInMsec; }
+
   bool IsLiveSession() { return fSocket.IsConnected() && fLiveSession; }
 
   void RefreshTimeout() { fTimeoutTask.RefreshTimeout(); }
@@ -117,6 +133,9 @@ class HTTPSessionInterface : public Thread::Task {
   bool fAuthenticated;
 
   static std::atomic_uint sSessionIndexCounter;
+  static std::atomic_uint sNumSessions;
+  static UInt32 sMaxRequestBodySize;
+  static UInt32 sCGITimeoutInMsec;
 
   static HTTPDispatcher *sDispatcher;
 
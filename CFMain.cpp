@@ -1,7 +1,10 @@
 #include <CF/CF.h>
 #include <CF/CFState.h>
 #include <CF/Net/Socket/Socket.h>
+#include <CF/Net/Socket/EventPoller.h>
 #include <CF/Net/Socket/SocketUtils.h>
+#include <CF/Net/Socket/TCPListenerSocket.h>
+#include <CF/Net/Socket/ClientSocket.h>
 #include <CF/CFConfigure.hpp>
 
 using namespace CF;
@@ -17,6 +20,8 @@ using namespace CF;
 
 std::atomic<UInt32> CFState::sState(0); /* 框架内部状态标识 */
 Queue CFState::sListenerSocket;
+Core::Mutex CFState::sStateMutex;
+Core::Cond CFState::sStateCond;
 
 CF_Error CFMain(CFConfigure *config) {
   CF_Error theErr;
@@ -47,9 +52,14 @@ CF_Error CFMain(CFConfigure *config) {
 
   UInt32 numShortTaskThreads = config->GetShortTaskThreads();
   UInt32 numBlockingThreads = config->GetBlockingThreads();
+  bool threadPerCore =
+      config->GetEventModel() == CFConfigure::kThreadPerCoreModel;
 
   if (Utils::ThreadSafe()) {
-    if (numShortTaskThreads == 0) {
+    if (numShortTaskThreads == 0 && threadPerCore) {
+      // one run-to-completion thread per processor
+      numShortTaskThreads = Utils::GetNumProcessors();
+    } else if (numShortTaskThreads == 0) {
       UInt32 numProcessors = Utils::GetNumProcessors();
       // 1 worker Thread per processor, up to 2 threads.
       // Note: Limiting the number of worker threads to 2 on a MacOS X system
@@ -76,7 +86,9 @@ CF_Error CFMain(CFConfigure *config) {
   s_printf("Add threads short_task=%" _U32BITARG_ " blocking=%" _U32BITARG_ "\n",
            numShortTaskThreads, numBlockingThreads);
 
-  Thread::TaskThreadPool::CreateThreads(numShortTaskThreads, numBlockingThreads);
+  Thread::TaskThreadPool::CreateThreads(
+      numShortTaskThreads, numBlockingThreads,
+      threadPerCore ? &Net::EventPoller::Create : nullptr);
 
   theErr = config->AfterConfigThreads(numThreads);
   if (theErr != CF_NoErr) return theErr;
@@ -92,13 +104,24 @@ CF_Error CFMain(CFConfigure *config) {
   // this be done before starting the sockets and server tasks
   Thread::TimeoutTask::Initialize();
 
+#if !MACOSXEVENTQUEUE
+  ::select_setbusypoll(config->GetEventBusyPollUSec());
+#endif
+  Net::Socket::SetDefaultBusyPoll(config->GetSocketBusyPollUSec());
+  Net::TCPListenerSocket::SetDefaultFastOpen(config->GetTCPFastOpenQueueLength());
+  Net::TCPListenerSocket::SetDefaultDeferAccept(config->GetTCPDeferAcceptSec());
+  Net::TCPListenerSocket::SetDefaultBufSizes(config->GetListenerRcvBufSize(),
+                                             config->GetSessionSndBufSize());
+  Net::TCPListenerSocket::SetDefaultBufferPolicy(
+      (Net::TCPListenerSocket::BufferPolicy) config->GetSocketBufferPolicy());
+  Net::Socket::SetSndBufBudget(config->GetSocketBufferBudget());
+  Net::TCPClientSocket::SetDefaultFastOpen(config->GetTCPFastOpenConnect());
+
   // Make sure to do this stuff last. Because these are all the threads that
   // do work in the server, this ensures that no work can go on while the
   // server is in the process of staring up
   Net::Socket::StartThread();
 
-  Core::Thread::Sleep(1000);
-
   theErr = config->AfterConfigFramework();
   if (theErr != CF_NoErr) return theErr;
 
@@ -120,13 +143,7 @@ CF_Error CFMain(CFConfigure *config) {
    * Listen status loop
    */
 
-  while (!CFEnv::WillExit()) {
-#ifdef __sgi__
-    Core::Thread::Sleep(999);
-#else
-    Core::Thread::Sleep(1000);
-#endif
-
+  while (!CFEnv::WaitForExit(1000)) {
     // do some statistics
     config->DoIdle();
   }
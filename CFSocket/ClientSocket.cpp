@@ -126,8 +126,10 @@ OS_Error ClientSocket::SendSendBuffer(TCPSocket *inSocket) {
   return theErr;
 }
 
+bool TCPClientSocket::sFastOpen = false;
+
 TCPClientSocket::TCPClientSocket(UInt32 inSocketType)
-    : fSocket(nullptr, inSocketType) {
+    : fSocket(nullptr, inSocketType), fFastOpen(sFastOpen) {
   //
   // It is necessary to open the Socket right when we construct the
   // object because the QTSSSplitterModule that uses this class uses
@@ -180,6 +182,19 @@ OS_Error TCPClientSocket::SendV(iovec *inVec, UInt32 inNumVecs) {
     }
   }
 
+  if (fFastOpen && !fSocket.IsConnected()) {
+    OS_Error theErr = this->fastOpen();
+    if (theErr != EOPNOTSUPP) {
+      if (theErr != OS_NoErr)
+        return theErr;
+      if (fSentLength == fSendBuffer.Len) { // all of it went with the SYN
+        fSendBuffer.Len = fSentLength = 0;
+        return OS_NoErr;
+      }
+      return this->SendSendBuffer(&fSocket);
+    }
+  }
+
   OS_Error theErr = this->Connect(&fSocket);
   if (theErr != OS_NoErr)
     return theErr;
@@ -187,6 +202,27 @@ OS_Error TCPClientSocket::SendV(iovec *inVec, UInt32 inNumVecs) {
   return this->SendSendBuffer(&fSocket);
 }
 
+OS_Error TCPClientSocket::fastOpen() {
+  // the kernel defers the handshake, SendSendBuffer's send puts the data in the SYN
+  if (fSocket.SetFastOpenConnect() == OS_NoErr)
+    return this->Connect(&fSocket);
+
+  // older kernels: connect and send with one sendto
+  UInt32 theLengthSent = 0;
+  OS_Error theErr = fSocket.ConnectAndSend(fHostAddr, fHostPort,
+                                           fSendBuffer.Ptr, fSendBuffer.Len, &theLengthSent);
+  if (theErr == EOPNOTSUPP)
+    return theErr;
+
+  fSentLength += theLengthSent;
+  if (theErr == EINPROGRESS || theErr == EAGAIN) {
+    // no cookie yet, only the SYN went out; resend when connected
+    fSocketP = &fSocket;
+    fEventMask = EV_WR;
+  }
+  return theErr;
+}
+
 OS_Error TCPClientSocket::Read(void *inBuffer,
                                const UInt32 inLength,
                                UInt32 *outRcvLen) {
@@ -0,0 +1,530 @@
+#include <random>
+#include <stdio.h>
+#include <CF/Net/Socket/DNSResolver.h>
+#include <CF/Core/Time.h>
+
+#if !__WinSock__
+
+#include <arpa/inet.h>
+
+#endif
+
+using namespace CF::Net;
+
+DNSResolver *DNSResolver::sResolver = nullptr;
+
+namespace {
+
+enum {
+  kHeaderSize = 12,
+  kTypeA = 1,
+  kTypeCNAME = 5,
+  kClassIN = 1,
+  kFlagQR = 0x8000,
+  kFlagTC = 0x0200,
+  kFlagRD = 0x0100,
+  kRcodeMask = 0x000F,
+  kRcodeNXDomain = 3,
+  kMaxPointerJumps = 16
+};
+
+inline UInt16 readUInt16(char const *inPtr) {
+  return (UInt16) (((UInt8) inPtr[0] << 8) | (UInt8) inPtr[1]);
+}
+
+inline UInt32 readUInt32(char const *inPtr) {
+  return ((UInt32) (UInt8) inPtr[0] << 24) | ((UInt32) (UInt8) inPtr[1] << 16) |
+      ((UInt32) (UInt8) inPtr[2] << 8) | (UInt32) (UInt8) inPtr[3];
+}
+
+inline void writeUInt16(char *inPtr, UInt16 inValue) {
+  inPtr[0] = (char) (inValue >> 8);
+  inPtr[1] = (char) inValue;
+}
+
+inline char toLower(char inChar) {
+  return (inChar >= 'A' && inChar <= 'Z') ? (char) (inChar + ('a' - 'A')) : inChar;
+}
+
+/**
+ * Reads the name at *ioOffset as "a.b.c" in lower case, following
+ * compression pointers. *ioOffset is moved past the name as it appears at
+ * that position. outName may be nullptr to just skip the name.
+ */
+bool readName(char const *inPacket, UInt32 inLength, UInt32 *ioOffset,
+              char *outName, UInt32 *outNameLen) {
+  UInt32 theOffset = *ioOffset;
+  UInt32 theNameLen = 0;
+  UInt32 theNumJumps = 0;
+  bool jumped = false;
+
+  while (true) {
+    if (theOffset >= inLength) return false;
+    auto theLabelLen = (UInt8) inPacket[theOffset];
+
+    if ((theLabelLen & 0xC0) == 0xC0) {
+      if (theOffset + 1 >= inLength || ++theNumJumps > kMaxPointerJumps)
+        return false;
+      if (!jumped) *ioOffset = theOffset + 2;
+      jumped = true;
+      theOffset = readUInt16(inPacket + theOffset) & 0x3FFFU;
+      continue;
+    }
+    if ((theLabelLen & 0xC0) != 0) return false;
+
+    theOffset++;
+    if (theLabelLen == 0) break;
+    if (theOffset + theLabelLen > inLength) return false;
+
+    if (outName != nullptr) {
+      UInt32 theNeeded = theLabelLen + (theNameLen > 0 ? 1 : 0);
+      if (theNameLen + theNeeded > DNSResolver::kMaxNameLength) return false;
+      if (theNameLen > 0) outName[theNameLen++] = '.';
+      for (UInt32 i = 0; i < theLabelLen; i++)
+        outName[theNameLen++] = toLower(inPacket[theOffset + i]);
+    }
+    theOffset += theLabelLen;
+  }
+
+  if (!jumped) *ioOffset = theOffset;
+  if (outNameLen != nullptr) *outNameLen = theNameLen;
+  return true;
+}
+
+}
+
+DNSResolver::Entry::Entry(StrPtrLen const &inName, UInt32 inHashValue)
+    : fNameLen(inName.Len),
+      fAddr(0), fErr(OS_NoErr), fExpires(0),
+      fPending(false), fQueryID(0), fAttempts(0), fDeadline(0),
+      fPendingElem(),
+      fHashValue(inHashValue), fNextHashEntry(nullptr) {
+  Assert(inName.Len <= kMaxNameLength);
+  ::memcpy(fName, inName.Ptr, inName.Len);
+  fName[inName.Len] = '\0';
+  fPendingElem.SetEnclosingObject(this);
+}
+
+DNSResolver::Entry::~Entry() {
+  while (QueueElem *theElem = fWaiters.DeQueue())
+    delete (Waiter *) theElem->GetEnclosingObject();
+}
+
+void DNSResolver::Initialize(UInt32 inServerAddr, UInt16 inServerPort) {
+  Assert(sResolver == nullptr);
+  if (inServerAddr == 0)
+    inServerAddr = readServerAddr();
+
+  sResolver = new DNSResolver(inServerAddr, inServerPort);
+  OS_Error theErr = sResolver->Open();
+  AssertV(theErr == OS_NoErr, theErr);
+}
+
+void DNSResolver::Release() {
+  if (sResolver != nullptr) {
+    sResolver->Signal(Task::kKillEvent);
+    sResolver = nullptr;
+  }
+}
+
+UInt32 DNSResolver::readServerAddr() {
+  UInt32 theAddr = 0;
+#if !__WinSock__
+  FILE *theFile = ::fopen("/etc/resolv.conf", "r");
+  if (theFile != nullptr) {
+    char theLine[256];
+    char theAddrStr[64];
+    while (theAddr == 0 && ::fgets(theLine, sizeof(theLine), theFile) != nullptr) {
+      struct in_addr theInAddr;
+      if (::sscanf(theLine, " nameserver %63s", theAddrStr) == 1 &&
+          ::inet_pton(AF_INET, theAddrStr, &theInAddr) == 1) // skip IPv6 servers
+        theAddr = ntohl(theInAddr.s_addr);
+    }
+    ::fclose(theFile);
+  }
+#endif
+  return theAddr != 0 ? theAddr : INADDR_LOOPBACK;
+}
+
+DNSResolver::DNSResolver(UInt32 inServerAddr, UInt16 inServerPort)
+    : IdleTask(),
+      fSocket(nullptr),
+      fServerAddr(inServerAddr),
+      fServerPort(inServerPort),
+      fEntries(kEntryTableSize),
+      fNextSweep(0) {
+  this->SetTaskName("DNSResolver");
+
+  // together with the source port, which changes with each batch of
+  // queries (see openSocket), this makes forged answers hard to match, so
+  // seed from the system's entropy
+  std::random_device theDevice;
+  fRandom = theDevice();
+  if (fRandom == 0) fRandom = (UInt32) Core::Time::Microseconds() | 1;
+}
+
+DNSResolver::~DNSResolver() {
+  Core::MutexLocker locker(&fMutex);
+  delete fSocket;
+  for (UInt32 i = 0; i < fEntries.GetTableSize(); i++) {
+    Entry *theEntry = fEntries.GetTableEntry(i);
+    while (theEntry != nullptr) {
+      Entry *theNext = theEntry->fNextHashEntry;
+      delete theEntry;
+      theEntry = theNext;
+    }
+  }
+}
+
+OS_Error DNSResolver::Open() {
+  Core::MutexLocker locker(&fMutex);
+  return this->openSocket();
+}
+
+OS_Error DNSResolver::openSocket() {
+  auto *theSocket = new UDPSocket(this, Socket::kNonBlockingSocketType);
+  OS_Error theErr = theSocket->Open();
+  if (theErr == OS_NoErr)
+    theErr = theSocket->Bind(INADDR_ANY, 0); // the kernel picks a random port
+  if (theErr != OS_NoErr) {
+    delete theSocket;
+    return theErr;
+  }
+
+  // the old one has no query in flight, late answers to it are dropped
+  delete fSocket;
+  fSocket = theSocket;
+  fSocket->RequestEvent(EV_RE);
+  return OS_NoErr;
+}
+
+UInt32 DNSResolver::hashName(char const *inName, UInt32 inNameLen) {
+  // FNV-1a
+  UInt32 theHash = 2166136261U;
+  for (UInt32 i = 0; i < inNameLen; i++) {
+    theHash ^= (UInt8) inName[i];
+    theHash *= 16777619U;
+  }
+  return theHash;
+}
+
+UInt16 DNSResolver::nextQueryID() {
+  // xorshift32
+  fRandom ^= fRandom << 13;
+  fRandom ^= fRandom >> 17;
+  fRandom ^= fRandom << 5;
+  return (UInt16) (fRandom >> 8);
+}
+
+OS_Error DNSResolver::Resolve(StrPtrLen const &inName, Thread::Task *inTask, UInt32 *outAddr) {
+  Assert(outAddr != nullptr);
+
+  UInt32 theLen = inName.Len;
+  if (theLen > 0 && inName.Ptr[theLen - 1] == '.') theLen--; // fully qualified
+  if (theLen == 0 || theLen > kMaxNameLength)
+    return EINVAL;
+
+  char theName[kMaxNameLength + 1];
+  for (UInt32 i = 0; i < theLen; i++)
+    theName[i] = toLower(inName.Ptr[i]);
+  theName[theLen] = '\0';
+
+  struct in_addr theInAddr;
+  if (::inet_pton(AF_INET, theName, &theInAddr) == 1) {
+    *outAddr = ntohl(theInAddr.s_addr);
+    return OS_NoErr;
+  }
+
+  UInt32 theHashValue = hashName(theName, theLen);
+  EntryKey theKey(theName, theLen, theHashValue);
+  SInt64 theNow = Core::Time::Milliseconds();
+
+  Core::MutexLocker locker(&fMutex);
+  Entry *theEntry = fEntries.Map(&theKey);
+
+  if (theEntry != nullptr && !theEntry->fPending && theEntry->fExpires > theNow) {
+    *outAddr = theEntry->fAddr;
+    return theEntry->fErr;
+  }
+
+  bool isNewQuery = false;
+  if (theEntry == nullptr) {
+    theEntry = new Entry(StrPtrLen(theName, theLen), theHashValue);
+    fEntries.Add(theEntry);
+    isNewQuery = true;
+  } else if (!theEntry->fPending) { // expired
+    isNewQuery = true;
+  }
+
+  if (isNewQuery) {
+    // a new batch of queries starts from a new source port; if that fails
+    // the old one still works
+    if (fPending.GetLength() == 0)
+      (void) this->openSocket();
+
+    theEntry->fQueryID = 0;
+    theEntry->fAttempts = 0;
+    OS_Error theErr = this->sendQuery(theEntry);
+    if (theErr != OS_NoErr && theErr != EAGAIN) { // EAGAIN: retried by the timer
+      this->removeEntry(theEntry);
+      return theErr;
+    }
+    theEntry->fPending = true;
+    fPending.EnQueue(&theEntry->fPendingElem);
+
+    // let Run arm the retransmit timer
+    this->Signal(Task::kUpdateEvent);
+  }
+
+  // coalesce: one query, every task that asked is notified
+  if (inTask != nullptr) {
+    bool isWaiting = false;
+    for (QueueIter qIter(&theEntry->fWaiters); !qIter.IsDone(); qIter.Next())
+      if (((Waiter *) qIter.GetCurrent()->GetEnclosingObject())->fTask == inTask) {
+        isWaiting = true;
+        break;
+      }
+    if (!isWaiting) {
+      auto *theWaiter = new Waiter;
+      theWaiter->fTask = inTask;
+      theWaiter->fElem.SetEnclosingObject(theWaiter);
+      theEntry->fWaiters.EnQueue(&theWaiter->fElem);
+    }
+  }
+  return EINPROGRESS;
+}
+
+void DNSResolver::Cancel(Thread::Task *inTask) {
+  Core::MutexLocker locker(&fMutex);
+  for (QueueIter qIter(&fPending); !qIter.IsDone(); qIter.Next()) {
+    auto *theEntry = (Entry *) qIter.GetCurrent()->GetEnclosingObject();
+    for (QueueIter wIter(&theEntry->fWaiters); !wIter.IsDone(); wIter.Next()) {
+      auto *theWaiter = (Waiter *) wIter.GetCurrent()->GetEnclosingObject();
+      if (theWaiter->fTask == inTask) {
+        theEntry->fWaiters.Remove(&theWaiter->fElem);
+        delete theWaiter;
+        break;
+      }
+    }
+  }
+}
+
+OS_Error DNSResolver::sendQuery(Entry *ioEntry) {
+  if (ioEntry->fQueryID == 0) {
+    // ids of the queries in flight must differ, 0 is reserved as "none"
+    UInt16 theID;
+    bool isUsed;
+    do {
+      theID = this->nextQueryID();
+      isUsed = theID == 0;
+      for (QueueIter qIter(&fPending); !isUsed && !qIter.IsDone(); qIter.Next())
+        isUsed = ((Entry *) qIter.GetCurrent()->GetEnclosingObject())->fQueryID == theID;
+    } while (isUsed);
+    ioEntry->fQueryID = theID;
+  }
+
+  char thePacket[kHeaderSize + kMaxNameLength + 2 + 4];
+  ::memset(thePacket, 0, kHeaderSize);
+  writeUInt16(thePacket, ioEntry->fQueryID);
+  writeUInt16(thePacket + 2, kFlagRD);
+  writeUInt16(thePacket + 4, 1); // QDCOUNT
+
+  // "www.example.com" -> 3www7example3com0
+  UInt32 theOffset = kHeaderSize;
+  char const *theLabel = ioEntry->fName;
+  char const *theEnd = ioEntry->fName + ioEntry->fNameLen;
+  while (theLabel < theEnd) {
+    auto *theDot = (char const *) ::memchr(theLabel, '.', theEnd - theLabel);
+    if (theDot == nullptr) theDot = theEnd;
+    auto theLabelLen = (UInt32) (theDot - theLabel);
+    if (theLabelLen == 0 || theLabelLen > 63)
+      return EINVAL;
+    thePacket[theOffset++] = (char) theLabelLen;
+    ::memcpy(thePacket + theOffset, theLabel, theLabelLen);
+    theOffset += theLabelLen;
+    theLabel = theDot + 1;
+  }
+  thePacket[theOffset++] = 0;
+  writeUInt16(thePacket + theOffset, kTypeA);
+  writeUInt16(thePacket + theOffset + 2, kClassIN);
+  theOffset += 4;
+
+  ioEntry->fAttempts++;
+  ioEntry->fDeadline = Core::Time::Milliseconds() + kRetryTimeoutInMsec;
+  return fSocket->SendTo(fServerAddr, fServerPort, thePacket, theOffset);
+}
+
+void DNSResolver::processResponse(char *inPacket, UInt32 inLength) {
+  if (inLength < kHeaderSize) return;
+
+  UInt16 theID = readUInt16(inPacket);
+  UInt16 theFlags = readUInt16(inPacket + 2);
+  UInt16 theQDCount = readUInt16(inPacket + 4);
+  UInt16 theANCount = readUInt16(inPacket + 6);
+  if ((theFlags & kFlagQR) == 0 || theQDCount != 1) return;
+
+  Entry *theEntry = nullptr;
+  for (QueueIter qIter(&fPending); !qIter.IsDone(); qIter.Next()) {
+    auto *thePending = (Entry *) qIter.GetCurrent()->GetEnclosingObject();
+    if (thePending->fQueryID == theID) {
+      theEntry = thePending;
+      break;
+    }
+  }
+  if (theEntry == nullptr) return; // late or forged
+
+  // the question must be ours as well
+  char theName[kMaxNameLength + 1];
+  UInt32 theNameLen;
+  UInt32 theOffset = kHeaderSize;
+  if (!readName(inPacket, inLength, &theOffset, theName, &theNameLen) ||
+      theOffset + 4 > inLength)
+    return;
+  if (theNameLen != theEntry->fNameLen || ::memcmp(theName, theEntry->fName, theNameLen) != 0 ||
+      readUInt16(inPacket + theOffset) != kTypeA || readUInt16(inPacket + theOffset + 2) != kClassIN)
+    return;
+  theOffset += 4;
+
+  UInt16 theRcode = theFlags & kRcodeMask;
+  if (theRcode == kRcodeNXDomain) {
+    this->complete(theEntry, 0, ENOENT, kNegativeTTLInSec);
+    return;
+  } else if (theRcode != 0) {
+    this->complete(theEntry, 0, EIO, kNegativeTTLInSec);
+    return;
+  }
+
+  // follow the CNAME chain from the question, in the order servers send
+  // it; records about other names are skipped, they may be planted. The
+  // shortest TTL on the way bounds how long the answer is valid
+  UInt32 theTTL = kMaxTTLInSec;
+  char theOwner[kMaxNameLength + 1];
+  UInt32 theOwnerLen;
+  for (UInt16 i = 0; i < theANCount; i++) {
+    if (!readName(inPacket, inLength, &theOffset, theOwner, &theOwnerLen) ||
+        theOffset + 10 > inLength)
+      break;
+    UInt16 theType = readUInt16(inPacket + theOffset);
+    UInt16 theClass = readUInt16(inPacket + theOffset + 2);
+    UInt32 theRecordTTL = readUInt32(inPacket + theOffset + 4);
+    UInt16 theDataLen = readUInt16(inPacket + theOffset + 8);
+    theOffset += 10;
+    if (theOffset + theDataLen > inLength) break;
+
+    if (theClass == kClassIN && theOwnerLen == theNameLen &&
+        ::memcmp(theOwner, theName, theNameLen) == 0) {
+      if (theType == kTypeA && theDataLen == 4) {
+        if (theRecordTTL < theTTL) theTTL = theRecordTTL;
+        this->complete(theEntry, readUInt32(inPacket + theOffset), OS_NoErr, theTTL);
+        return;
+      }
+      if (theType == kTypeCNAME) {
+        // the name the rest of the chain is about
+        UInt32 theTargetOffset = theOffset;
+        if (!readName(inPacket, inLength, &theTargetOffset, theName, &theNameLen))
+          break;
+        if (theRecordTTL < theTTL) theTTL = theRecordTTL;
+      }
+    }
+    theOffset += theDataLen;
+  }
+
+  // a truncated answer would need TCP, which isn't supported
+  this->complete(theEntry, 0, (theFlags & kFlagTC) ? EIO : ENOENT, kNegativeTTLInSec);
+}
+
+void DNSResolver::complete(Entry *ioEntry, UInt32 inAddr, OS_Error inErr, UInt32 inTTLInSec) {
+  if (inTTLInSec < kMinTTLInSec) inTTLInSec = kMinTTLInSec;
+  if (inTTLInSec > kMaxTTLInSec) inTTLInSec = kMaxTTLInSec;
+
+  fPending.Remove(&ioEntry->fPendingElem);
+  ioEntry->fPending = false;
+  ioEntry->fQueryID = 0;
+  ioEntry->fAddr = inAddr;
+  ioEntry->fErr = inErr;
+  ioEntry->fExpires = Core::Time::Milliseconds() + (SInt64) inTTLInSec * 1000;
+
+  while (QueueElem *theElem = ioEntry->fWaiters.DeQueue()) {
+    auto *theWaiter = (Waiter *) theElem->GetEnclosingObject();
+    theWaiter->fTask->Signal(Task::kUpdateEvent);
+    delete theWaiter;
+  }
+}
+
+void DNSResolver::removeEntry(Entry *inEntry) {
+  if (inEntry->fPending)
+    fPending.Remove(&inEntry->fPendingElem);
+  fEntries.Remove(inEntry);
+  delete inEntry;
+}
+
+SInt64 DNSResolver::checkTimers(SInt64 inNow) {
+  SInt64 theNextDeadline = 0;
+
+  for (QueueIter qIter(&fPending); !qIter.IsDone();) {
+    auto *theEntry = (Entry *) qIter.GetCurrent()->GetEnclosingObject();
+    qIter.Next(); // complete removes it from the queue
+
+    if (theEntry->fDeadline <= inNow) {
+      if (theEntry->fAttempts >= kMaxAttempts) {
+        this->complete(theEntry, 0, ETIMEDOUT, kNegativeTTLInSec);
+        continue;
+      }
+      (void) this->sendQuery(theEntry); // a failed send is retried like a lost one
+    }
+    if (theNextDeadline == 0 || theEntry->fDeadline < theNextDeadline)
+      theNextDeadline = theEntry->fDeadline;
+  }
+
+  // drop expired results now and then, names asked once would pile up otherwise
+  if (inNow >= fNextSweep) {
+    for (UInt32 i = 0; i < fEntries.GetTableSize(); i++) {
+      Entry *theEntry = fEntries.GetTableEntry(i);
+      while (theEntry != nullptr) {
+        Entry *theNext = theEntry->fNextHashEntry;
+        if (!theEntry->fPending && theEntry->fExpires <= inNow)
+          this->removeEntry(theEntry);
+        theEntry = theNext;
+      }
+    }
+    fNextSweep = inNow + kSweepIntervalInMsec;
+  }
+
+  if (fEntries.GetNumEntries() > 0 &&
+      (theNextDeadline == 0 || fNextSweep < theNextDeadline))
+    theNextDeadline = fNextSweep;
+
+  if (theNextDeadline == 0)
+    return 0; // nothing to wait for
+
+  SInt64 theTimeout = theNextDeadline - inNow;
+  return theTimeout > 0 ? theTimeout : 1;
+}
+
+SInt64 DNSResolver::Run() {
+  EventFlags theEvents = this->GetEvents();
+  if (theEvents & Task::kKillEvent)
+    return -1;
+
+  Core::MutexLocker locker(&fMutex);
+
+  if (theEvents & Task::kReadEvent) {
+    char thePacket[kMaxPacketSize];
+    UInt32 theAddr, theLen;
+    UInt16 thePort;
+    while (fSocket->RecvFrom(&theAddr, &thePort, thePacket, sizeof(thePacket), &theLen) == OS_NoErr) {
+      if (theAddr != fServerAddr || thePort != fServerPort)
+        continue;
+      this->processResponse(thePacket, theLen);
+    }
+    fSocket->RequestEvent(EV_RE);
+  }
+
+  // a task waiting in the TaskThread's timer heap doesn't see Signal, so
+  // the timer runs on the idle thread and events keep coming in between
+  SInt64 theTimeout = this->checkTimers(Core::Time::Milliseconds());
+  this->CancelTimeout();
+  if (theTimeout > 0)
+    this->SetIdleTimer(theTimeout);
+  return 0;
+}
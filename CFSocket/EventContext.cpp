@@ -29,6 +29,7 @@
  */
 
 #include <CF/Net/Socket/EventContext.h>
+#include <CF/Net/Socket/EventPoller.h>
 #include <CF/Net/Socket/TCPListenerSocket.h>
 #include <CF/CFState.h>
 
@@ -42,9 +43,10 @@
 #include "CF/Net/tempcalls.h" //includes MacOS X prototypes of event Queue functions
 #endif
 
+#include <CF/Core/Time.h>
+
 #if DEBUG_EVENT_CONTEXT
 #include <CF/Utils.h>
-#include <CF/Core/Time.h>
 #endif
 
 using namespace CF::Net;
@@ -59,10 +61,13 @@ std::atomic<unsigned int> EventContext::sUniqueID(1);
 EventContext::EventContext(SOCKET inFileDesc, EventThread *inThread)
     : fFileDesc(inFileDesc),
       fUseETMode(false),
+      fReadyBits(0),
       fUniqueID(0),
       fUniqueIDStr((char *) &fUniqueID, sizeof(fUniqueID)),
       fEventThread(inThread),
+      fPoller(nullptr),
       fWatchEventCalled(false),
+      fEventRemoved(false),
       fEventBits(0),
       fAutoCleanup(true),
       fTask(nullptr) {}
@@ -87,14 +92,20 @@ void EventContext::Cleanup() {
   SOCKET fd = fFileDesc;
   fFileDesc = kInvalidFileDesc;
   fWatchEventCalled = false;
+  fEventRemoved = false;
+  fReadyBits = 0;
 
   // 关闭 Socket
   if (fd != kInvalidFileDesc) {
     // if this object is registered in the table, unregister it now
     if (fUniqueID > 0) {
+      if (fPoller != nullptr)
+        fPoller->RemoveEvent(fd);
 #if !MACOSXEVENTQUEUE
-      select_removeevent(fFileDesc);  // 先取消 event 监听
+      else
+        select_removeevent(fd);  // 先取消 event 监听
 #endif
+      fEventThread->fMetrics.RecordRemove();
       fEventThread->fRefTable.UnRegister(&fRef);  // 从 EventThread 注销
     }
 
@@ -139,6 +150,9 @@ void EventContext::SnarfEventContext(EventContext &fromContext) {
   fromContext.fFileDesc = kInvalidFileDesc;
 
   fWatchEventCalled = fromContext.fWatchEventCalled;
+  fEventRemoved = fromContext.fEventRemoved;
+  fUseETMode = fromContext.fUseETMode;
+  fReadyBits = fromContext.fReadyBits.load();
   fUniqueID = fromContext.fUniqueID;
   fUniqueIDStr.Set((char *) &fUniqueID, sizeof(fUniqueID)),
       ::memcpy(&fEventReq, &fromContext.fEventReq, sizeof(struct eventreq));
@@ -146,6 +160,11 @@ void EventContext::SnarfEventContext(EventContext &fromContext) {
   fRef.Set(fUniqueIDStr, this);
   fEventThread->fRefTable.Swap(&fRef);
   fEventThread->fRefTable.UnRegister(&fromContext.fRef);
+
+  // the poller dispatches on the context pointer, point it at us
+  fPoller = fromContext.fPoller;
+  if (fPoller != nullptr && fWatchEventCalled && !fEventRemoved)
+    fPoller->ModWatch(this, fEventReq.er_eventbits);
 }
 
 void EventContext::RequestEvent(UInt32 theMask) {
@@ -157,8 +176,17 @@ void EventContext::RequestEvent(UInt32 theMask) {
 
   if (theMask & EV_RM) { // 处理删除事件
     DEBUG_LOG(0, "EventContext@%p remove event.\n", this);
-    if (fWatchEventCalled) {
-      select_removeevent(fFileDesc);
+    if (fWatchEventCalled && !fEventRemoved) {
+      if (fPoller != nullptr)
+        fPoller->RemoveEvent(fFileDesc);
+      else
+        select_removeevent(fFileDesc);
+      fEventThread->fMetrics.RecordRemove();
+
+      // the next request arms the fd again, in ET mode too; what was
+      // ready is reported again when it is added back
+      fEventRemoved = true;
+      fReadyBits = 0;
     }
     return;
   }
@@ -172,15 +200,29 @@ void EventContext::RequestEvent(UInt32 theMask) {
   // the way the MacOS X event Queue works.
 
 #if EVENT_EDGE_TRIGGERED_SUPPORTED
-  if (fUseETMode) theMask |= EV_ET; // ET Mode
+  if (fUseETMode) {
+    // ET 模式下 fd 只注册一次，读写事件持久有效。已注册时不再 modwatch，
+    // 但如果请求的事件仍处于就绪状态(调用方未读/写到 EAGAIN)，边沿不会
+    // 再次触发，需要直接唤醒 Task。
+    if (fWatchEventCalled && !fEventRemoved) {
+      UInt32 readyBits = fReadyBits & theMask & (EV_RE | EV_WR);
+      if (readyBits != 0 && fTask != nullptr)
+        fTask->Signal(ToTaskEvents(readyBits));
+      return;
+    }
+    theMask = (theMask & ~EV_OS) | EV_RE | EV_WR | EV_ET;
+  }
 #endif
 
   if (fWatchEventCalled) {
+    fEventRemoved = false;
     fEventReq.er_eventbits = theMask;
+    fEventThread->fMetrics.RecordModWatch();
 #if MACOSXEVENTQUEUE
     if (modwatch(&fEventReq, theMask) != 0)
 #else
-    if (select_modwatch(&fEventReq, theMask) != 0)
+    if ((fPoller != nullptr ? fPoller->ModWatch(this, theMask)
+                            : select_modwatch(&fEventReq, theMask)) != 0)
 #endif
 #if __WinSock__
       AssertV(false, ::WSAGetLastError());
@@ -244,16 +286,37 @@ void EventContext::RequestEvent(UInt32 theMask) {
     fEventReq.er_data = (void *) fUniqueID;
 
     fWatchEventCalled = true;
+    fEventThread->fMetrics.RecordWatch();
 #if MACOSXEVENTQUEUE
     if (watchevent(&fEventReq, theMask) != 0)
 #else
-    if (select_watchevent(&fEventReq, theMask) != 0)
+    if ((fPoller != nullptr ? fPoller->WatchEvent(this, theMask)
+                            : select_watchevent(&fEventReq, theMask)) != 0)
 #endif
       //this should never fail, but if it does, cleanup.
       AssertV(false, Core::Thread::GetErrno());
   }
 }
 
+void EventContext::DispatchEvent(int eventBits) {
+  if (fUseETMode)
+    this->SetReady(eventBits & (EV_RE | EV_WR));
+
+  if (eventBits & EV_ER) {
+    // EPOLLERR 也可能只是错误队列里的通知(如 MSG_ZEROCOPY 完成)，交给 owner
+    // 处理；不是通知时按挂断处理，由 read 取得具体错误
+    eventBits &= ~EV_ER;
+    if (this->ReapErrorQueue())
+      eventBits |= EV_WR; // completions release send buffers
+    else
+      eventBits |= EV_RE | EV_HU;
+  }
+
+  if (eventBits & EV_HU)
+    this->SetReady(EV_HU);
+  this->ProcessEvent(eventBits);
+}
+
 /**
  * 网络事件线程入口，由一个大循环组成
  */
@@ -268,11 +331,25 @@ void EventThread::Entry() {
 
       // wait for Net event
 #if MACOSXEVENTQUEUE
+      bool willWait = true;
+      SInt64 theWaitStart = Core::Time::Microseconds();
       int theReturnValue = waitevent(&theCurrentEvent, NULL);
 #else
+      bool willWait = select_pendingevents() == 0;
+      SInt64 theWaitStart = willWait ? Core::Time::Microseconds() : 0;
       int theReturnValue = select_waitevent(&theCurrentEvent, nullptr);
 #endif
 
+      if (willWait) {
+        fBatchStartUSec = Core::Time::Microseconds();
+#if MACOSXEVENTQUEUE
+        UInt32 theNumEvents = theReturnValue == 0 ? 1 : 0;
+#else
+        UInt32 theNumEvents = theReturnValue == 0 ? 1 + select_pendingevents() : 0;
+#endif
+        fMetrics.RecordWait(fBatchStartUSec - theWaitStart, theNumEvents);
+      }
+
       static const UInt32 sStopState = CFState::kKillListener | CFState::kCleanEvent;
       if (CFState::sState & sStopState) {
         // kill listener Socket
@@ -285,7 +362,8 @@ void EventThread::Entry() {
             listener->Signal(CF::Thread::Task::kKillEvent);
             delete elem;
           }
-          CFState::sState ^= CFState::kKillListener;
+          CFState::NotifyProcessState(CFState::kKillListener);
+          theErr = EINTR; // theCurrentEvent is not valid, wait again
           continue;
         }
 
@@ -300,8 +378,9 @@ void EventThread::Entry() {
             theContext->DontAutoCleanup();
             theContext->Cleanup();
           }
-          CFState::sState ^= CFState::kCleanEvent;
+          CFState::NotifyProcessState(CFState::kCleanEvent);
           /* kCleanEvent 必 kDisableEvent，此时 select 模型再也不会产生新事件 */
+          theErr = EINTR;
           continue;
         }
       }
@@ -326,9 +405,14 @@ void EventThread::Entry() {
 #if DEBUG_EVENT_CONTEXT
         theContext->fModwatched = false;
 #endif
-        theContext->ProcessEvent(theCurrentEvent.er_eventbits);
+        theContext->DispatchEvent(theCurrentEvent.er_eventbits);
         fRefTable.Release(ref);
+        fMetrics.RecordDispatch(Core::Time::Microseconds() - fBatchStartUSec);
+      } else {
+        fMetrics.RecordResolveMiss();
       }
+    } else {
+      fMetrics.RecordResolveMiss();
     }
 
 #if DEBUG_EVENT_CONTEXT
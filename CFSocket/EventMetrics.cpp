@@ -0,0 +1,84 @@
+#include <CF/Net/Socket/EventMetrics.h>
+#include <CF/Core/Time.h>
+
+using namespace CF::Net;
+
+EventMetrics::EventMetrics()
+    : fNumWaits(0),
+      fNumEmptyWaits(0),
+      fTotalWaitUSec(0),
+      fNumEvents(0),
+      fTotalDispatchUSec(0),
+      fMaxDispatchUSec(0),
+      fLagUSec(0),
+      fNumResolveMisses(0),
+      fNumWatches(0),
+      fNumModWatches(0),
+      fNumRemoves(0) {
+  for (UInt32 i = 0; i < kNumHistogramBuckets; i++) {
+    fWaitHistogram[i] = 0;
+    fBatchHistogram[i] = 0;
+    fDispatchHistogram[i] = 0;
+  }
+}
+
+UInt32 EventMetrics::GetBucket(UInt64 inValue) {
+  UInt32 theBucket = 0;
+  while (inValue > 1 && theBucket < kNumHistogramBuckets - 1) {
+    inValue >>= 1;
+    theBucket++;
+  }
+  return theBucket;
+}
+
+void EventMetrics::RecordWait(SInt64 inWaitUSec, UInt32 inNumEvents) {
+  if (inWaitUSec < 0) inWaitUSec = 0; // the clock may step backwards
+
+  Increment(fNumWaits);
+  Increment(fTotalWaitUSec, (UInt64) inWaitUSec);
+  Increment(fWaitHistogram[GetBucket((UInt64) inWaitUSec)]);
+
+  if (inNumEvents == 0) {
+    Increment(fNumEmptyWaits);
+  } else {
+    Increment(fNumEvents, inNumEvents);
+    Increment(fBatchHistogram[GetBucket(inNumEvents)]);
+  }
+}
+
+void EventMetrics::RecordDispatch(SInt64 inDispatchUSec) {
+  if (inDispatchUSec < 0) inDispatchUSec = 0;
+
+  Increment(fTotalDispatchUSec, (UInt64) inDispatchUSec);
+  Increment(fDispatchHistogram[GetBucket((UInt64) inDispatchUSec)]);
+  if ((UInt64) inDispatchUSec > fMaxDispatchUSec.load(std::memory_order_relaxed))
+    fMaxDispatchUSec.store((UInt64) inDispatchUSec, std::memory_order_relaxed);
+
+  UInt64 theLag = fLagUSec.load(std::memory_order_relaxed);
+  fLagUSec.store(theLag - (theLag >> 3) + ((UInt64) inDispatchUSec >> 3),
+                 std::memory_order_relaxed);
+}
+
+void EventMetrics::GetSnapshot(Snapshot *outSnapshot) {
+  Assert(outSnapshot != nullptr);
+
+  // counters are read one by one, the snapshot is not atomic as a whole
+  outSnapshot->fSampleTimeMilli = Core::Time::Milliseconds();
+  outSnapshot->fNumWaits = fNumWaits;
+  outSnapshot->fNumEmptyWaits = fNumEmptyWaits;
+  outSnapshot->fTotalWaitUSec = fTotalWaitUSec;
+  outSnapshot->fNumEvents = fNumEvents;
+  outSnapshot->fTotalDispatchUSec = fTotalDispatchUSec;
+  outSnapshot->fMaxDispatchUSec = fMaxDispatchUSec;
+  outSnapshot->fLagUSec = fLagUSec;
+  outSnapshot->fNumResolveMisses = fNumResolveMisses;
+  outSnapshot->fNumWatches = fNumWatches;
+  outSnapshot->fNumModWatches = fNumModWatches;
+  outSnapshot->fNumRemoves = fNumRemoves;
+
+  for (UInt32 i = 0; i < kNumHistogramBuckets; i++) {
+    outSnapshot->fWaitHistogram[i] = fWaitHistogram[i];
+    outSnapshot->fBatchHistogram[i] = fBatchHistogram[i];
+    outSnapshot->fDispatchHistogram[i] = fDispatchHistogram[i];
+  }
+}
@@ -0,0 +1,119 @@
+#include <CF/Net/Socket/EventPoller.h>
+
+#if __Linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace CF::Net;
+
+std::atomic_uint EventPoller::sThreadPicker(0);
+
+CF::Thread::TaskThreadPoller *EventPoller::Create() {
+#if __Linux__
+  int theEpollFD = ::epoll_create1(EPOLL_CLOEXEC);
+  if (theEpollFD == -1) return nullptr;
+
+  int theWakeupFD = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (theWakeupFD == -1) {
+    ::close(theEpollFD);
+    return nullptr;
+  }
+
+  // data.ptr == nullptr marks the wakeup fd, every other entry is a context
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  if (::epoll_ctl(theEpollFD, EPOLL_CTL_ADD, theWakeupFD, &ev) == -1) {
+    ::close(theWakeupFD);
+    ::close(theEpollFD);
+    return nullptr;
+  }
+
+  return new EventPoller(theEpollFD, theWakeupFD);
+#else
+  return nullptr;
+#endif
+}
+
+CF::Thread::TaskThread *EventPoller::PickThread() {
+  UInt32 theNumThreads = Thread::TaskThreadPool::GetNumShortTaskThreads();
+  if (theNumThreads == 0) return nullptr;
+
+  Thread::TaskThread *theThread =
+      Thread::TaskThreadPool::GetThread(sThreadPicker.fetch_add(1) % theNumThreads);
+  if (theThread == nullptr || theThread->GetPoller() == nullptr)
+    return nullptr;
+  return theThread;
+}
+
+EventPoller::EventPoller(int inEpollFD, int inWakeupFD)
+    : fEpollFD(inEpollFD), fWakeupFD(inWakeupFD) {}
+
+EventPoller::~EventPoller() {
+#if __Linux__
+  ::close(fWakeupFD);
+  ::close(fEpollFD);
+#endif
+}
+
+void EventPoller::Poll(SInt64 inTimeoutMilli) {
+#if __Linux__
+  struct epoll_event theEvents[kMaxEventsPerPoll];
+
+  int theNumEvents = ::epoll_wait(fEpollFD, theEvents, kMaxEventsPerPoll, (int) inTimeoutMilli);
+
+  // 在本线程内直接分发，批次内不会执行任何 Task，所以 data.ptr 在此期间有效
+  for (int i = 0; i < theNumEvents; i++) {
+    if (theEvents[i].data.ptr == nullptr) {
+      eventfd_t theValue;
+      (void) ::eventfd_read(fWakeupFD, &theValue);
+      continue;
+    }
+
+    auto *theContext = (EventContext *) theEvents[i].data.ptr;
+    theContext->DispatchEvent(epoll_toeventbits(theEvents[i].events));
+  }
+#endif
+}
+
+void EventPoller::Wakeup() {
+#if __Linux__
+  (void) ::eventfd_write(fWakeupFD, 1);
+#endif
+}
+
+int EventPoller::WatchEvent(EventContext *inContext, int which) {
+#if __Linux__
+  struct epoll_event ev;
+  ev.events = epoll_fromeventbits(which);
+  ev.data.ptr = inContext;
+  return ::epoll_ctl(fEpollFD, EPOLL_CTL_ADD, inContext->fFileDesc, &ev);
+#else
+  return -1;
+#endif
+}
+
+int EventPoller::ModWatch(EventContext *inContext, int which) {
+#if __Linux__
+  struct epoll_event ev;
+  ev.events = epoll_fromeventbits(which);
+  ev.data.ptr = inContext;
+  int ret = ::epoll_ctl(fEpollFD, EPOLL_CTL_MOD, inContext->fFileDesc, &ev);
+  if (ret == -1 && errno == ENOENT) // removed by RemoveEvent, add it back
+    ret = ::epoll_ctl(fEpollFD, EPOLL_CTL_ADD, inContext->fFileDesc, &ev);
+  return ret;
+#else
+  return -1;
+#endif
+}
+
+int EventPoller::RemoveEvent(SOCKET inFileDesc) {
+#if __Linux__
+  return ::epoll_ctl(fEpollFD, EPOLL_CTL_DEL, inFileDesc, nullptr);
+#else
+  return -1;
+#endif
+}
@@ -34,6 +34,7 @@
 
 #include <CF/Net/Socket/Socket.h>
 #include <CF/Net/Socket/SocketUtils.h>
+#include <CF/Core/Time.h>
 
 #if !__WinSock__
 
@@ -42,6 +43,27 @@
 #include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if __Linux__
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+
+// older headers lack the MSG_ZEROCOPY definitions (Linux 4.14)
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+#endif
 
 #endif
 
@@ -58,6 +80,9 @@ typedef int socklen_t; // missing from some platform includes
 using namespace CF::Net;
 
 EventThread *Socket::sEventThread = nullptr;
+UInt32 Socket::sBusyPollUSec = 0;
+UInt64 Socket::sSndBufBudget = 0;
+std::atomic<UInt64> Socket::sSndBufInUse(0);
 
 Socket::Socket(CF::Thread::Task *inNotifyTask, UInt32 inSocketType)
     : EventContext(EventContext::kInvalidFileDesc, sEventThread),
@@ -78,6 +103,31 @@ Socket::Socket(CF::Thread::Task *inNotifyTask, UInt32 inSocketType)
   fLocalAddrStr.Set(fLocalAddrBuffer, sizeof(fLocalAddrBuffer));
 #endif
 
+#if __Linux__
+  fSplicePipe[0] = fSplicePipe[1] = -1;
+  fSplicePending = 0;
+
+  fZeroCopyThreshold = 0;
+  fZeroCopyEnabled = false;
+  fZeroCopySeq = 0;
+  fZeroCopyDone = 0;
+
+  fSndBufSize = 0;
+  fSndBufMin = fSndBufMax = 0;
+  fSndBufSampleTime = 0;
+  fSndBufSampleBytes = 0;
+  fSndBufBlocked = false;
+#endif
+}
+
+Socket::~Socket() {
+#if __Linux__
+  sSndBufInUse -= fSndBufSize;
+  if (fSplicePipe[0] != -1) {
+    ::close(fSplicePipe[0]);
+    ::close(fSplicePipe[1]);
+  }
+#endif
 }
 
 OS_Error Socket::Open(int theType) {
@@ -95,6 +145,9 @@ OS_Error Socket::Open(int theType) {
   if (fState & kEdgeTriggeredSocketMode)
     this->SetMode(true);
 
+  if (sBusyPollUSec > 0)
+    this->BusyPoll(sBusyPollUSec);
+
   return OS_NoErr;
 }
 
@@ -119,6 +172,16 @@ void Socket::KeepAlive() {
   Assert(err == 0);
 }
 
+void Socket::BusyPoll(UInt32 inBusyPollUSec) {
+#ifdef SO_BUSY_POLL
+  int value = inBusyPollUSec;
+  int err = ::setsockopt(
+      fFileDesc, SOL_SOCKET, SO_BUSY_POLL, (char *) &value, sizeof(int));
+  // needs CAP_NET_ADMIN to raise above net.core.busy_read, not fatal
+  WarnV(err == 0, "Socket::BusyPoll failed to set SO_BUSY_POLL");
+#endif
+}
+
 void Socket::SetSocketBufSize(UInt32 inNewSize) {
 
 #if DEBUG_SOCKET
@@ -296,9 +359,26 @@ Send(char const *inData, const UInt32 inLength, UInt32 *outLengthSent) {
   if (!(fState & kConnected))
     return (OS_Error) ENOTCONN;
 
+  // ET 模式下先清除就绪状态，若系统调用期间有新的边沿到来，EventThread 会重新置位
+  if (this->IsETMode()) this->ClearReady(EV_WR);
+
+  int theFlags = 0;
+#if __Linux__
+  UInt32 theThreshold = fZeroCopyThreshold;
+  if (theThreshold > 0 && inLength >= theThreshold)
+    theFlags = MSG_ZEROCOPY;
+#endif
+
   long err;
   do {
-    err = ::send(fFileDesc, inData, inLength, 0);
+    err = ::send(fFileDesc, inData, inLength, theFlags);
+#if __Linux__
+    // the pinned page limit (optmem) is reached, take the copy path this time
+    if ((err == -1) && (theFlags != 0) && (Core::Thread::GetErrno() == ENOBUFS)) {
+      theFlags = 0;
+      err = ::send(fFileDesc, inData, inLength, 0);
+    }
+#endif
   } while ((err == -1) && (Core::Thread::GetErrno() == EINTR));
 
   if (err == -1) {
@@ -307,9 +387,17 @@ Send(char const *inData, const UInt32 inLength, UInt32 *outLengthSent) {
     int theErr = Core::Thread::GetErrno();
     if ((theErr != EAGAIN) && (this->IsConnected()))
       fState ^= kConnected;//turn off connected state flag
+#if __Linux__
+    if (theErr == EAGAIN && fSndBufSize > 0) this->adaptSndBuf(0, true);
+#endif
     return (OS_Error) theErr;
   }
 
+#if __Linux__
+  if (theFlags != 0) fZeroCopySeq++;
+  if (fSndBufSize > 0) this->adaptSndBuf((UInt32) err, false);
+#endif
+  if (this->IsETMode()) this->SetReady(EV_WR);
   *outLengthSent = static_cast<UInt32>(err);
   return OS_NoErr;
 }
@@ -321,6 +409,20 @@ WriteV(const struct iovec *iov, const UInt32 numIOvecs, UInt32 *outLenSent) {
   if (!(fState & kConnected))
     return (OS_Error) ENOTCONN;
 
+  if (this->IsETMode()) this->ClearReady(EV_WR);
+
+#if __Linux__
+  int theFlags = 0;
+  UInt32 theThreshold = fZeroCopyThreshold;
+  if (theThreshold > 0) {
+    size_t theLength = 0;
+    for (UInt32 i = 0; i < numIOvecs; i++)
+      theLength += iov[i].iov_len;
+    if (theLength >= theThreshold)
+      theFlags = MSG_ZEROCOPY;
+  }
+#endif
+
   long err;
   do {
 #if __WinSock__
@@ -328,6 +430,20 @@ WriteV(const struct iovec *iov, const UInt32 numIOvecs, UInt32 *outLenSent) {
     err = ::WSASend(fFileDesc, (LPWSABUF)iov, numIOvecs, &theBytesSent, 0, nullptr, nullptr);
     if (err == 0)
         err = theBytesSent;
+#elif __Linux__
+    if (theFlags != 0) {
+      struct msghdr theMsg;
+      ::memset(&theMsg, 0, sizeof(theMsg));
+      theMsg.msg_iov = (struct iovec *) iov;
+      theMsg.msg_iovlen = numIOvecs;
+      err = ::sendmsg(fFileDesc, &theMsg, theFlags);
+      if ((err == -1) && (Core::Thread::GetErrno() == ENOBUFS)) {
+        theFlags = 0; // see Send
+        err = ::writev(fFileDesc, iov, numIOvecs);
+      }
+    } else {
+      err = ::writev(fFileDesc, iov, numIOvecs);
+    }
 #else
     err = ::writev(fFileDesc, iov, numIOvecs); // return ssize_t
 #endif
@@ -339,15 +455,289 @@ WriteV(const struct iovec *iov, const UInt32 numIOvecs, UInt32 *outLenSent) {
     int theErr = Core::Thread::GetErrno();
     if ((theErr != EAGAIN) && (this->IsConnected()))
       fState ^= kConnected;//turn off connected state flag
+#if __Linux__
+    if (theErr == EAGAIN && fSndBufSize > 0) this->adaptSndBuf(0, true);
+#endif
     return (OS_Error) theErr;
   }
 
+#if __Linux__
+  if (theFlags != 0) fZeroCopySeq++;
+  if (fSndBufSize > 0) this->adaptSndBuf((UInt32) err, false);
+#endif
+  if (this->IsETMode()) this->SetReady(EV_WR);
   if (outLenSent != nullptr)
     *outLenSent = (UInt32) err;
 
   return OS_NoErr;
 }
 
+OS_Error Socket::
+SendFile(int inFileDesc, UInt64 *ioOffset, UInt32 inLength, UInt32 *outLengthSent) {
+  Assert(ioOffset != nullptr);
+  Assert(outLengthSent != nullptr);
+  *outLengthSent = 0;
+
+  if (!(fState & kConnected))
+    return (OS_Error) ENOTCONN;
+
+  if (inLength == 0)
+    return OS_NoErr;
+
+#if __WinSock__
+  return (OS_Error) ENOSYS; // TransmitFile is not wired up
+#else
+  if (this->IsETMode()) this->ClearReady(EV_WR);
+
+  long err;
+#if __Linux__
+  if (fSplicePending == 0) {
+    off_t theOffset = (off_t) *ioOffset;
+    do {
+      err = ::sendfile(fFileDesc, inFileDesc, &theOffset, inLength);
+    } while ((err == -1) && (Core::Thread::GetErrno() == EINTR));
+
+    // the file can't be mmap'ed (e.g. a pipe or some special fs), splice it
+    if ((err == -1) && ((Core::Thread::GetErrno() == EINVAL) ||
+                        (Core::Thread::GetErrno() == ENOSYS)))
+      err = this->spliceFile(inFileDesc, *ioOffset, inLength);
+  } else {
+    err = this->spliceFile(inFileDesc, *ioOffset, inLength);
+  }
+#else
+  // no zero-copy primitive here, one copy through a stack buffer
+  char theBuffer[16 * 1024];
+  do {
+    err = ::pread(inFileDesc, theBuffer,
+                  inLength < sizeof(theBuffer) ? inLength : sizeof(theBuffer),
+                  (off_t) *ioOffset);
+  } while ((err == -1) && (Core::Thread::GetErrno() == EINTR));
+  if (err > 0) {
+    long theLen = err;
+    do {
+      err = ::send(fFileDesc, theBuffer, (size_t) theLen, 0);
+    } while ((err == -1) && (Core::Thread::GetErrno() == EINTR));
+  }
+#endif
+
+  if (err == -1) {
+    int theErr = Core::Thread::GetErrno();
+    if ((theErr != EAGAIN) && (this->IsConnected()))
+      fState ^= kConnected;//turn off connected state flag
+#if __Linux__
+    if (theErr == EAGAIN && fSndBufSize > 0) this->adaptSndBuf(0, true);
+#endif
+    return (OS_Error) theErr;
+  }
+
+#if __Linux__
+  if (fSndBufSize > 0) this->adaptSndBuf((UInt32) err, false);
+#endif
+  if (this->IsETMode()) this->SetReady(EV_WR);
+  *ioOffset += err;
+  *outLengthSent = static_cast<UInt32>(err);
+  return OS_NoErr;
+#endif
+}
+
+#if __Linux__
+long Socket::spliceFile(int inFileDesc, UInt64 inOffset, UInt32 inLength) {
+  if (fSplicePipe[0] == -1 &&
+      ::pipe2(fSplicePipe, O_NONBLOCK | O_CLOEXEC) == -1)
+    return -1;
+
+  // bytes in the pipe are the file range [inOffset, inOffset + fSplicePending)
+  long err;
+  if (fSplicePending < inLength) {
+    loff_t theOffset = (loff_t) (inOffset + fSplicePending);
+    do {
+      err = ::splice(inFileDesc, &theOffset, fSplicePipe[1], nullptr,
+                     inLength - fSplicePending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    } while ((err == -1) && (Core::Thread::GetErrno() == EINTR));
+
+    if (err > 0)
+      fSplicePending += (UInt32) err;
+    else if ((err == -1) && (Core::Thread::GetErrno() != EAGAIN))
+      return -1; // EAGAIN: the pipe is full
+  }
+
+  if (fSplicePending == 0)
+    return 0; // end of file
+
+  do {
+    err = ::splice(fSplicePipe[0], nullptr, fFileDesc, nullptr,
+                   fSplicePending < inLength ? fSplicePending : inLength,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  } while ((err == -1) && (Core::Thread::GetErrno() == EINTR));
+
+  if (err > 0)
+    fSplicePending -= (UInt32) err;
+  return err;
+}
+#endif
+
+void Socket::SetAdaptiveSndBuf(UInt32 inMinSize, UInt32 inMaxSize) {
+#if __Linux__
+  Assert(inMinSize > 0 && inMinSize <= inMaxSize);
+  fSndBufMin = inMinSize;
+  fSndBufMax = inMaxSize;
+  fSndBufSampleTime = Core::Time::Milliseconds();
+  fSndBufSampleBytes = 0;
+  fSndBufBlocked = false;
+  this->setSndBuf(inMinSize);
+#endif
+}
+
+void Socket::TrimSndBuf() {
+#if __Linux__
+  if (fSndBufSize > fSndBufMin && sSndBufBudget > 0 && sSndBufInUse > sSndBufBudget) {
+    this->setSndBuf(fSndBufMin);
+    fSndBufSampleTime = Core::Time::Milliseconds();
+    fSndBufSampleBytes = 0;
+    fSndBufBlocked = false;
+  }
+#endif
+}
+
+#if __Linux__
+void Socket::setSndBuf(UInt32 inSize) {
+  // the kernel doubles the value for its bookkeeping overhead
+  int theSize = (int) (inSize / 2);
+  if (::setsockopt(fFileDesc, SOL_SOCKET, SO_SNDBUF, (char *) &theSize, sizeof(int)) != 0)
+    return;
+  sSndBufInUse += (UInt64) inSize - fSndBufSize; // wraps correctly when shrinking
+  fSndBufSize = inSize;
+}
+
+void Socket::adaptSndBuf(UInt32 inLengthSent, bool inBlocked) {
+  static const SInt64 kSampleInMsec = 200;
+
+  fSndBufSampleBytes += inLengthSent;
+  if (inBlocked) fSndBufBlocked = true;
+
+  SInt64 theNow = Core::Time::Milliseconds();
+  SInt64 theElapsed = theNow - fSndBufSampleTime;
+  if (theElapsed < kSampleInMsec) return;
+
+  struct tcp_info theInfo;
+  socklen_t theLen = sizeof(theInfo);
+  if (::getsockopt(fFileDesc, IPPROTO_TCP, TCP_INFO, &theInfo, &theLen) == 0 && theInfo.tcpi_rtt > 0) {
+    // bandwidth-delay product of what was actually sent
+    UInt64 theRate = fSndBufSampleBytes * 1000 / (UInt64) theElapsed;
+    UInt64 theBDP = theRate * theInfo.tcpi_rtt / 1000000;
+
+    UInt64 theTarget;
+    if (fSndBufBlocked) {
+      // the buffer may be what limits us, allow what the network takes per RTT
+      UInt64 theWindow = (UInt64) theInfo.tcpi_snd_cwnd * theInfo.tcpi_snd_mss;
+      theTarget = 2 * (theWindow > theBDP ? theWindow : theBDP);
+    } else {
+      theTarget = 2 * theBDP; // 0 when idle
+    }
+    if (theTarget < fSndBufMin) theTarget = fSndBufMin;
+    if (theTarget > fSndBufMax) theTarget = fSndBufMax;
+
+    if (theTarget > fSndBufSize && sSndBufBudget > 0 &&
+        sSndBufInUse + (theTarget - fSndBufSize) > sSndBufBudget)
+      theTarget = fSndBufSize; // no room to grow
+
+    // resize on real changes only, not on every jitter of the samples
+    if (theTarget > fSndBufSize + fSndBufSize / 4 || theTarget < fSndBufSize - fSndBufSize / 4)
+      this->setSndBuf((UInt32) theTarget);
+  }
+
+  fSndBufSampleTime = theNow;
+  fSndBufSampleBytes = 0;
+  fSndBufBlocked = false;
+}
+#endif
+
+OS_Error Socket::SetZeroCopyThreshold(UInt32 inThreshold) {
+#if __Linux__
+  if (inThreshold > 0 && !fZeroCopyEnabled) {
+    if (fFileDesc == EventContext::kInvalidFileDesc)
+      return (OS_Error) EBADF;
+
+    int one = 1;
+    int err = ::setsockopt(fFileDesc, SOL_SOCKET, SO_ZEROCOPY, (char *) &one, sizeof(int));
+    if (err == -1)
+      return (OS_Error) Core::Thread::GetErrno();
+    fZeroCopyEnabled = true;
+  }
+
+  // SO_ZEROCOPY stays set, completions of earlier sends are still reaped
+  fZeroCopyThreshold = inThreshold;
+  return OS_NoErr;
+#else
+  return inThreshold > 0 ? (OS_Error) ENOSYS : OS_NoErr;
+#endif
+}
+
+UInt32 Socket::GetZeroCopySeq() {
+#if __Linux__
+  return fZeroCopySeq;
+#else
+  return 0;
+#endif
+}
+
+bool Socket::IsZeroCopyDone(UInt32 inSeq) {
+#if __Linux__
+  return (SInt32) (fZeroCopyDone.load() - inSeq) >= 0;
+#else
+  return true;
+#endif
+}
+
+UInt32 Socket::ReapZeroCopy() {
+  UInt32 theNumReaped = 0;
+#if __Linux__
+  if (!fZeroCopyEnabled) return 0;
+
+  char theControl[128];
+  struct msghdr theMsg;
+  for (;;) {
+    ::memset(&theMsg, 0, sizeof(theMsg));
+    theMsg.msg_control = theControl;
+    theMsg.msg_controllen = sizeof(theControl);
+
+    long err;
+    do {
+      err = ::recvmsg(fFileDesc, &theMsg, MSG_ERRQUEUE);
+    } while ((err == -1) && (Core::Thread::GetErrno() == EINTR));
+    if (err == -1) break; // EAGAIN: the queue is empty
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&theMsg); cm != nullptr; cm = CMSG_NXTHDR(&theMsg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+        continue;
+
+      auto *theErr = (struct sock_extended_err *) CMSG_DATA(cm);
+      if (theErr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || theErr->ee_errno != 0)
+        continue;
+
+      // [ee_info, ee_data] is an inclusive range of send sequence numbers,
+      // TCP completes them in order
+      UInt32 theDone = theErr->ee_data + 1;
+      UInt32 theOld = fZeroCopyDone;
+      while ((SInt32) (theDone - theOld) > 0 &&
+             !fZeroCopyDone.compare_exchange_weak(theOld, theDone));
+
+      // the kernel copied the data anyway, zero-copy only adds overhead
+      if (theErr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        fZeroCopyThreshold = 0;
+
+      theNumReaped++;
+    }
+  }
+#endif
+  return theNumReaped;
+}
+
+bool Socket::ReapErrorQueue() {
+  return this->ReapZeroCopy() > 0;
+}
+
 OS_Error Socket::Read(void *buffer, const UInt32 length, UInt32 *outRecvLenP) {
   Assert(outRecvLenP != nullptr);
   Assert(buffer != nullptr);
@@ -355,6 +745,8 @@ OS_Error Socket::Read(void *buffer, const UInt32 length, UInt32 *outRecvLenP) {
   if (!(fState & kConnected))
     return (OS_Error) ENOTCONN;
 
+  if (this->IsETMode()) this->ClearReady(EV_RE);
+
   //int theRecvLen = ::recv(fFileDesc, buffer, length, 0);//flags??
   long theRecvLen;
   do {
@@ -383,6 +775,53 @@ OS_Error Socket::Read(void *buffer, const UInt32 length, UInt32 *outRecvLenP) {
     return (OS_Error) ENOTCONN;
   }
   Assert(theRecvLen > 0);
+  if (this->IsETMode()) this->SetReady(EV_RE);
+  *outRecvLenP = (UInt32) theRecvLen;
+  return OS_NoErr;
+}
+
+OS_Error Socket::ReadV(const struct iovec *iov, const UInt32 numIOvecs, UInt32 *outRecvLenP) {
+  Assert(outRecvLenP != nullptr);
+  Assert(iov != nullptr);
+
+  if (!(fState & kConnected))
+    return (OS_Error) ENOTCONN;
+
+  if (this->IsETMode()) this->ClearReady(EV_RE);
+
+  long theRecvLen;
+  do {
+#if __WinSock__
+    DWORD theBytesRecvd = 0;
+    DWORD theFlags = 0;
+    theRecvLen = ::WSARecv(fFileDesc, (LPWSABUF) iov, numIOvecs, &theBytesRecvd, &theFlags, nullptr, nullptr);
+    if (theRecvLen == 0)
+      theRecvLen = theBytesRecvd;
+  } while ((theRecvLen == SOCKET_ERROR) && (::WSAGetLastError() == WSAEINTR));
+
+  if (theRecvLen == SOCKET_ERROR) {
+    int theErr = ::WSAGetLastError();
+    if ((theErr != WSAEWOULDBLOCK) && (this->IsConnected()))
+#else
+    theRecvLen = ::readv(fFileDesc, iov, numIOvecs);
+  } while ((theRecvLen == -1) && (Core::Thread::GetErrno() == EINTR));
+
+  if (theRecvLen == -1) {
+    // Are there any errors that can happen if the client is connected?
+    // Yes... EAGAIN. Means the Socket is now flow-controled
+    int theErr = Core::Thread::GetErrno();
+    if ((theErr != EAGAIN) && (this->IsConnected()))
+#endif
+      fState ^= kConnected; // turn off connected state flag
+    return (OS_Error) theErr;
+  } else if (theRecvLen == 0) {
+    // if we get 0 bytes back from read, that means the client has disconnected.
+    // Note that and return the proper error to the caller
+    fState ^= kConnected;
+    return (OS_Error) ENOTCONN;
+  }
+  Assert(theRecvLen > 0);
+  if (this->IsETMode()) this->SetReady(EV_RE);
   *outRecvLenP = (UInt32) theRecvLen;
   return OS_NoErr;
 }
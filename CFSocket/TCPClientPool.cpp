@@ -0,0 +1,249 @@
+#include <CF/Net/Socket/TCPClientPool.h>
+#include <CF/Core/Time.h>
+
+#if !__WinSock__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#endif
+
+using namespace CF::Net;
+
+TCPClientPool::PooledSocket::PooledSocket(Host *inHost)
+    : TCPClientSocket(Socket::kNonBlockingSocketType),
+      fHost(inHost), fIdleSince(0), fElem() {
+  fElem.SetEnclosingObject(this);
+  this->Set(inHost->fAddr, inHost->fPort);
+}
+
+TCPClientPool::Host::Host(UInt32 inAddr, UInt16 inPort)
+    : fAddr(inAddr), fPort(inPort), fNumOpen(0),
+      fHashValue(HostKey::hash(inAddr, inPort)), fNextHashEntry(nullptr) {}
+
+TCPClientPool::TCPClientPool(UInt32 inMaxPerHost, UInt32 inIdleTimeoutInMsec)
+    : Task(),
+      fHosts(kHostTableSize),
+      fMaxPerHost(inMaxPerHost > 0 ? inMaxPerHost : 1),
+      fIdleTimeoutInMsec(inIdleTimeoutInMsec) {
+  this->SetTaskName("TCPClientPool");
+  this->Signal(Task::kStartEvent); // start the idle timer
+}
+
+TCPClientPool::~TCPClientPool() {
+  Core::MutexLocker locker(&fMutex);
+  for (UInt32 i = 0; i < fHosts.GetTableSize(); i++) {
+    Host *theHost = fHosts.GetTableEntry(i);
+    while (theHost != nullptr) {
+      Host *theNext = theHost->fNextHashEntry;
+      while (QueueElem *theElem = theHost->fIdle.DeQueue())
+        delete (PooledSocket *) theElem->GetEnclosingObject();
+      while (QueueElem *theElem = theHost->fGranted.DeQueue()) {
+        auto *theWaiter = (Waiter *) theElem->GetEnclosingObject();
+        delete theWaiter->fSocket;
+        delete theWaiter;
+      }
+      while (QueueElem *theElem = theHost->fWaiters.DeQueue())
+        delete (Waiter *) theElem->GetEnclosingObject();
+      delete theHost;
+      theHost = theNext;
+    }
+  }
+}
+
+bool TCPClientPool::isHealthy(PooledSocket *inSocket) {
+  Socket *theSocket = inSocket->GetSocket();
+  if (!theSocket->IsConnected())
+    return false;
+
+  // an idle connection has nothing to read: 0 means the server closed it,
+  // data is a stale or unsolicited response, both make it unusable
+  char theByte;
+#if __WinSock__
+  int theLen = ::recv(theSocket->GetSocketFD(), &theByte, 1, MSG_PEEK);
+  return theLen == SOCKET_ERROR && ::WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  long theLen;
+  do {
+    theLen = ::recv(theSocket->GetSocketFD(), &theByte, 1, MSG_PEEK | MSG_DONTWAIT);
+  } while (theLen == -1 && Core::Thread::GetErrno() == EINTR);
+  return theLen == -1 && (Core::Thread::GetErrno() == EAGAIN ||
+                          Core::Thread::GetErrno() == EWOULDBLOCK);
+#endif
+}
+
+void TCPClientPool::closeSocket(PooledSocket *inSocket) {
+  Host *theHost = inSocket->fHost;
+  Assert(theHost->fNumOpen > 0);
+  theHost->fNumOpen--;
+  delete inSocket;
+  this->grant(theHost, nullptr);
+}
+
+void TCPClientPool::grant(Host *ioHost, PooledSocket *inSocket) {
+  QueueElem *theElem = ioHost->fWaiters.DeQueue();
+  if (theElem == nullptr) {
+    if (inSocket != nullptr) {
+      inSocket->fIdleSince = Core::Time::Milliseconds();
+      ioHost->fIdle.EnQueue(&inSocket->fElem);
+    }
+    return;
+  }
+
+  // reserve the connection, or the slot, for the first waiter
+  auto *theWaiter = (Waiter *) theElem->GetEnclosingObject();
+  theWaiter->fSocket = inSocket;
+  theWaiter->fGrantTime = Core::Time::Milliseconds();
+  if (inSocket == nullptr)
+    ioHost->fNumOpen++;
+  ioHost->fGranted.EnQueue(&theWaiter->fElem);
+  theWaiter->fTask->Signal(Task::kUpdateEvent);
+}
+
+CF::Net::TCPClientSocket *TCPClientPool::handOut(PooledSocket *inSocket, Thread::Task *inTask) {
+  inSocket->fIdleSince = 0;
+  inSocket->GetSocket()->SetTask(inTask);
+  return inSocket;
+}
+
+CF::Net::TCPClientSocket *TCPClientPool::Acquire(UInt32 inAddr, UInt16 inPort, Thread::Task *inTask) {
+  Core::MutexLocker locker(&fMutex);
+
+  HostKey theKey(inAddr, inPort);
+  Host *theHost = fHosts.Map(&theKey);
+  if (theHost == nullptr) {
+    theHost = new Host(inAddr, inPort);
+    fHosts.Add(theHost);
+  }
+
+  if (inTask != nullptr) {
+    // a reservation made for this task while it was waiting
+    for (QueueIter qIter(&theHost->fGranted); !qIter.IsDone(); qIter.Next()) {
+      auto *theWaiter = (Waiter *) qIter.GetCurrent()->GetEnclosingObject();
+      if (theWaiter->fTask != inTask) continue;
+
+      theHost->fGranted.Remove(&theWaiter->fElem);
+      PooledSocket *theSocket = theWaiter->fSocket;
+      delete theWaiter;
+      if (theSocket == nullptr) // the slot was counted by grant
+        theSocket = new PooledSocket(theHost);
+      return this->handOut(theSocket, inTask);
+    }
+
+    // keep the order, don't overtake tasks that were here first
+    for (QueueIter qIter(&theHost->fWaiters); !qIter.IsDone(); qIter.Next())
+      if (((Waiter *) qIter.GetCurrent()->GetEnclosingObject())->fTask == inTask)
+        return nullptr;
+  }
+
+  // most recently used first, it is the least likely to be timed out by the server
+  while (QueueElem *theElem = theHost->fIdle.GetTail()) {
+    auto *theSocket = (PooledSocket *) theElem->GetEnclosingObject();
+    theHost->fIdle.Remove(theElem);
+    if (this->isHealthy(theSocket))
+      return this->handOut(theSocket, inTask);
+
+    theHost->fNumOpen--;
+    delete theSocket;
+  }
+
+  if (theHost->fNumOpen < fMaxPerHost && theHost->fWaiters.GetLength() == 0) {
+    theHost->fNumOpen++;
+    return this->handOut(new PooledSocket(theHost), inTask);
+  }
+
+  if (inTask != nullptr) {
+    auto *theWaiter = new Waiter;
+    theWaiter->fTask = inTask;
+    theWaiter->fSocket = nullptr;
+    theWaiter->fGrantTime = 0;
+    theWaiter->fElem.SetEnclosingObject(theWaiter);
+    theHost->fWaiters.EnQueue(&theWaiter->fElem);
+  }
+  return nullptr;
+}
+
+void TCPClientPool::Release(TCPClientSocket *inSocket, bool inReusable) {
+  Assert(inSocket != nullptr);
+  auto *theSocket = static_cast<PooledSocket *>(inSocket);
+
+  Core::MutexLocker locker(&fMutex);
+  theSocket->GetSocket()->SetTask(nullptr);
+  if (inReusable && this->isHealthy(theSocket))
+    this->grant(theSocket->fHost, theSocket);
+  else
+    this->closeSocket(theSocket);
+}
+
+void TCPClientPool::CancelWait(Thread::Task *inTask) {
+  Core::MutexLocker locker(&fMutex);
+  for (UInt32 i = 0; i < fHosts.GetTableSize(); i++) {
+    for (Host *theHost = fHosts.GetTableEntry(i); theHost != nullptr; theHost = theHost->fNextHashEntry) {
+      for (QueueIter qIter(&theHost->fWaiters); !qIter.IsDone(); qIter.Next()) {
+        auto *theWaiter = (Waiter *) qIter.GetCurrent()->GetEnclosingObject();
+        if (theWaiter->fTask == inTask) {
+          theHost->fWaiters.Remove(&theWaiter->fElem);
+          delete theWaiter;
+          break;
+        }
+      }
+
+      for (QueueIter qIter(&theHost->fGranted); !qIter.IsDone(); qIter.Next()) {
+        auto *theWaiter = (Waiter *) qIter.GetCurrent()->GetEnclosingObject();
+        if (theWaiter->fTask == inTask) {
+          // pass the reservation on
+          theHost->fGranted.Remove(&theWaiter->fElem);
+          if (theWaiter->fSocket != nullptr) {
+            this->grant(theHost, theWaiter->fSocket);
+          } else {
+            theHost->fNumOpen--;
+            this->grant(theHost, nullptr);
+          }
+          delete theWaiter;
+          break;
+        }
+      }
+    }
+  }
+}
+
+void TCPClientPool::reapHost(Host *ioHost, SInt64 inNow) {
+  // the head is the oldest
+  while (QueueElem *theElem = ioHost->fIdle.GetHead()) {
+    auto *theSocket = (PooledSocket *) theElem->GetEnclosingObject();
+    if (inNow - theSocket->fIdleSince < fIdleTimeoutInMsec) break;
+    ioHost->fIdle.Remove(theElem);
+    ioHost->fNumOpen--;
+    delete theSocket;
+  }
+
+  // a task that doesn't come back for its reservation loses it
+  while (QueueElem *theElem = ioHost->fGranted.GetHead()) {
+    auto *theWaiter = (Waiter *) theElem->GetEnclosingObject();
+    if (inNow - theWaiter->fGrantTime < fIdleTimeoutInMsec) break;
+    ioHost->fGranted.Remove(theElem);
+    if (theWaiter->fSocket != nullptr)
+      this->closeSocket(theWaiter->fSocket);
+    else {
+      ioHost->fNumOpen--;
+      this->grant(ioHost, nullptr);
+    }
+    delete theWaiter;
+  }
+}
+
+SInt64 TCPClientPool::Run() {
+  EventFlags theEvents = this->GetEvents();
+  if (theEvents & Task::kKillEvent)
+    return -1;
+
+  Core::MutexLocker locker(&fMutex);
+  SInt64 theNow = Core::Time::Milliseconds();
+  for (UInt32 i = 0; i < fHosts.GetTableSize(); i++)
+    for (Host *theHost = fHosts.GetTableEntry(i); theHost != nullptr; theHost = theHost->fNextHashEntry)
+      this->reapHost(theHost, theNow);
+
+  // check twice per timeout, a connection lives at most 1.5 timeouts idle
+  SInt64 theInterval = fIdleTimeoutInMsec / 2;
+  return theInterval > 0 ? theInterval : 1;
+}
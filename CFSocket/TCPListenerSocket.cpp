@@ -29,6 +29,7 @@
  */
 
 #include <CF/Net/Socket/TCPListenerSocket.h>
+#include <CF/Net/Socket/EventPoller.h>
 
 #if !__WinSock__
 
@@ -37,11 +38,25 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #endif
 
 using namespace CF::Net;
 
+UInt32 TCPListenerSocket::sFastOpenQueueLength = 0;
+UInt32 TCPListenerSocket::sDeferAcceptSec = 0;
+UInt32 TCPListenerSocket::sRcvBufSize = 512 * 1024;
+UInt32 TCPListenerSocket::sSessionSndBufSize = 96 * 1024;
+TCPListenerSocket::BufferPolicy TCPListenerSocket::sBufferPolicy = TCPListenerSocket::kFixedBuffers;
+
+TCPListenerSocket::~TCPListenerSocket() {
+#if !__WinSock__
+  if (fReservedFileDesc != -1)
+    ::close(fReservedFileDesc);
+#endif
+}
+
 OS_Error TCPListenerSocket::listen(UInt32 queueLength) {
   if (fFileDesc == EventContext::kInvalidFileDesc)
     return (OS_Error) EBADF;
@@ -55,7 +70,7 @@ OS_Error TCPListenerSocket::listen(UInt32 queueLength) {
 /*
  * 创建打开流套接字(SOCK_STREAM)端口,并绑定 IP 地址、端口，执行 listen 操作。
  * 注意在这个函数里调用了 SetSocketRcvBufSize 成员函数,以设置这个 Socket 的
- * 接收缓冲区大小为 96K。而内核规定该值最大为 sysctl_rmem_max，可以通过
+ * 接收缓冲区大小(默认 512K)。而内核规定该值最大为 sysctl_rmem_max，可以通过
  * /proc/sys/Net/Core/rmem_default 和 /proc/sys/Net/Core/rmem_max 来了解缺省值
  * 和最大值。(注意 proc 下的这两个值也是可写的，可以通过调整这些值来达到优化
  * TCP/IP 的目的。
@@ -78,11 +93,39 @@ OS_Error TCPListenerSocket::Initialize(UInt32 addr, UInt16 port) {
       // Unfortunately we need to advertise a big buffer because our TCP sockets
       // can be used for incoming broadcast data. This could force the server
       // to run out of memory faster if it gets bogged down, but it is unavoidable.
-      this->SetSocketRcvBufSize(512 * 1024);
+      if (fBufferPolicy == kFixedBuffers && fRcvBufSize > 0)
+        this->SetSocketRcvBufSize(fRcvBufSize);
+
+      // both are optimizations, a kernel without them still serves connections
+#if defined(TCP_DEFER_ACCEPT)
+      if (fDeferAcceptSec > 0) {
+        int theSec = (int) fDeferAcceptSec;
+        if (::setsockopt(fFileDesc, IPPROTO_TCP, TCP_DEFER_ACCEPT, (char *) &theSec, sizeof(int)) != 0)
+          s_printf("TCPListenerSocket: TCP_DEFER_ACCEPT failed, err=%d\n", Core::Thread::GetErrno());
+      }
+#endif
+#if defined(TCP_FASTOPEN)
+      if (fFastOpenQueueLength > 0) {
+#if __macOS__
+        int theQueueLength = 1; // an on/off switch there
+#else
+        int theQueueLength = (int) fFastOpenQueueLength;
+#endif
+        if (::setsockopt(fFileDesc, IPPROTO_TCP, TCP_FASTOPEN, (char *) &theQueueLength, sizeof(int)) != 0)
+          s_printf("TCPListenerSocket: TCP_FASTOPEN failed, err=%d\n", Core::Thread::GetErrno());
+      }
+#endif
+
       err = this->listen(kListenQueueLength);
       AssertV(err == 0, Core::Thread::GetErrno());
       if (err != 0) break;
 
+#if !__WinSock__
+      // hold a spare descriptor, so that running out of descriptors degrades
+      // to refusing connections instead of leaving them in the backlog
+      fReservedFileDesc = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+#endif
+
     } while (false);
   }
 
@@ -124,7 +167,7 @@ void TCPListenerSocket::ProcessEvent(int /*eventBits*/) {
     // take a look at what this error is.
     int acceptError = Core::Thread::GetErrno();
 
-    if (acceptError == EAGAIN) {
+    if (acceptError == EAGAIN || acceptError == EWOULDBLOCK) {
       // If it's EAGAIN, there's nothing on the listen Queue right now,
       // so modwatch and return
 //      this->RequestEvent(EV_RE);
@@ -135,38 +178,35 @@ void TCPListenerSocket::ProcessEvent(int /*eventBits*/) {
     // test acceptError = EINTR;
     // test acceptError = ENOENT;
     if (acceptError == EMFILE || acceptError == ENFILE) {
-      // if these error gets returned, we're out of file descriptors, the server
-      // is going to be failing on sockets, logs, qtgroups and qtuser auth file
-      // accesses and movie files. The server is not functional.
-      s_printf("Out of File Descriptors. Set max connections lower and check"
-               " for competing usage from other processes. Exiting.");
-      exit(EXIT_FAILURE);
-    } else {
+      // if these error gets returned, we're out of file descriptors. Refuse
+      // the oldest pending connection and stop accepting for a while, the
+      // sessions that go away in the meantime give descriptors back.
+      if (!fOutOfDescriptors)
+        s_printf("Out of File Descriptors. Set max connections lower and check"
+                 " for competing usage from other processes. Pausing accept.\n");
+      fOutOfDescriptors = true;
+      this->RejectWithReservedFileDesc();
+      this->PauseAccepts();
+    } else if (acceptError == ENOBUFS || acceptError == ENOMEM) {
+      // the kernel is short of memory, back off as well
+      this->PauseAccepts();
+    } else if (acceptError != EINTR && acceptError != ECONNABORTED) {
+      // the pending connection is already gone, there is nothing to clean up
       char errStr[256];
       errStr[sizeof(errStr) - 1] = 0;
       s_snprintf(errStr, sizeof(errStr) - 1,
                  "accept error = %d '%s' on Socket. Clean up and continue.",
                  acceptError, strerror(acceptError));
       WarnV((acceptError == 0), errStr);
-
-      // TODO(james): there have some questions.
-//      theTask = this->GetSessionTask(&theSocket);
-//      if (theTask == nullptr) {
-//        close(osSocket);
-//      } else {
-//        theTask->Signal(Task::kKillEvent); // just clean up the task
-//      }
-//
-//      if (theSocket)
-//        theSocket->fState &= ~kConnected; // turn off connected state
-//
-//      return;
     }
+    return;
   }
 
+  fOutOfDescriptors = false;
+
   theTask = this->GetSessionTask(&theSocket);
-  if (theTask == nullptr) { //this should be a disconnect. do an ioctl call?
-    close(osSocket);
+  if (theTask == nullptr) { // refused by admission control
+    this->RejectConnection(osSocket);
     if (theSocket) theSocket->fState &= ~kConnected; // turn off connected state
   } else {
     Assert(osSocket != EventContext::kInvalidFileDesc);
@@ -180,18 +220,32 @@ void TCPListenerSocket::ProcessEvent(int /*eventBits*/) {
     err = ::setsockopt(osSocket, SOL_SOCKET, SO_KEEPALIVE, (char *) &one, sizeof(int));
     AssertV(err == 0, Core::Thread::GetErrno());
 
-    int sndBufSize = 96L * 1024L;
-    err = ::setsockopt(osSocket, SOL_SOCKET, SO_SNDBUF, (char *) &sndBufSize, sizeof(int));
-    AssertV(err == 0, Core::Thread::GetErrno());
+    if (fBufferPolicy == kFixedBuffers && fSessionSndBufSize > 0) {
+      int sndBufSize = (int) fSessionSndBufSize;
+      err = ::setsockopt(osSocket, SOL_SOCKET, SO_SNDBUF, (char *) &sndBufSize, sizeof(int));
+      AssertV(err == 0, Core::Thread::GetErrno());
+    }
 
     // setup the Socket. When there is data on the Socket,
     // theTask will get an kReadEvent event
     theSocket->Set(osSocket, &addr);
+    if (fBufferPolicy == kAdaptiveBuffers)
+      theSocket->SetAdaptiveSndBuf(kMinAdaptiveSndBuf, kMaxAdaptiveSndBuf);
     theSocket->InitNonBlocking(osSocket); // 因为 socket 是通过 Set 注入的，需要手动设置为 non-blocking
-    theTask->SetThreadPicker(Thread::Task::GetBlockingTaskThreadPicker()); // The Message Task processing threads
+    if (Socket::GetDefaultBusyPoll() > 0)
+      theSocket->BusyPoll(Socket::GetDefaultBusyPoll());
+    Thread::TaskThread *theThread = EventPoller::PickThread();
+    if (theThread != nullptr) {
+      // thread-per-core: 连接的 I/O 和 Task 都在选中的线程上完成
+      theTask->SetDefaultThread(theThread);
+      theSocket->SetPoller((EventPoller *) theThread->GetPoller());
+    } else {
+      theTask->SetThreadPicker(Thread::Task::GetBlockingTaskThreadPicker()); // The Message Task processing threads
+    }
     theSocket->SetTask(theTask); // 实际上是调用 EventContext::SetTask
 
     // 监听可读事件，提供 TCP 服务
+    // 对于 ET 模式的 Socket，这里会持久注册读写事件，不再是 one shot
     theSocket->RequestEvent(EV_REOS); // one shot
   }
 
@@ -201,17 +255,41 @@ void TCPListenerSocket::ProcessEvent(int /*eventBits*/) {
   if (fSleepBetweenAccepts) {
     // We are at our maximum supported sockets
     // slow down so we have Time to process the active ones (we will respond with errors or service).
-    // wake up and execute again after sleeping. The timer must be reset each Time through
     //s_printf("TCPListenerSocket slowing down\n");
-    this->RequestEvent(EV_RM); // 屏蔽事件，暂停服务
-    this->SetIdleTimer(kTimeBetweenAcceptsInMsec); //sleep 1 second
+    this->PauseAccepts();
   } else {
     // sleep until there is a read event outstanding (another client wants to connect)
     //s_printf("TCPListenerSocket normal speed\n");
     //this->RequestEvent(EV_RE);
   }
+}
+
+void TCPListenerSocket::RejectConnection(int osSocket) {
+  close(osSocket);
+}
+
+void TCPListenerSocket::PauseAccepts() {
+  // wake up and execute again after sleeping. The timer must be reset each Time through
+  if (fAcceptsPaused) return;
+  fAcceptsPaused = true;
+  this->RequestEvent(EV_RM); // 屏蔽事件，暂停服务
+  this->SetIdleTimer(kTimeBetweenAcceptsInMsec);
+}
+
+void TCPListenerSocket::RejectWithReservedFileDesc() {
+#if !__WinSock__
+  if (fReservedFileDesc == -1) return;
+
+  ::close(fReservedFileDesc);
+  fReservedFileDesc = -1;
 
-  fOutOfDescriptors = false; // always false for now we don't properly handle this elsewhere in the code
+  int osSocket = accept(fFileDesc, nullptr, nullptr);
+  if (osSocket != -1)
+    this->RejectConnection(osSocket);
+
+  // another thread may take the descriptor first, we try again next time
+  fReservedFileDesc = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+#endif
 }
 
 SInt64 TCPListenerSocket::Run() {
@@ -224,11 +302,14 @@ SInt64 TCPListenerSocket::Run() {
   if (events & Thread::Task::kKillEvent)
     return -1;
 
-  // This function will get called when we have run out of file descriptors.
-  // All we need to do is check the listen Queue to see if the situation has
-  // cleared up.
-  (void) this->GetEvents();
-  this->RequestEvent(EV_RE);
+  // This function will get called when accepts were paused, by admission
+  // control or because we have run out of file descriptors. Take one
+  // connection from the listen Queue to see if the situation has cleared up,
+  // and resume watching only if it has. Otherwise ProcessEvent has reset the
+  // idle timer.
+  fAcceptsPaused = false;
   this->ProcessEvent(Thread::Task::kReadEvent);
+  if (!fAcceptsPaused)
+    this->RequestEvent(EV_RE);
   return 0;
 }
@@ -36,6 +36,17 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#if __Linux__
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+#ifndef MSG_FASTOPEN
+#define MSG_FASTOPEN 0x20000000
+#endif
 #endif
 
 #ifdef USE_NETLOG
@@ -84,6 +95,10 @@ void TCPSocket::Set(int inSocket, struct sockaddr_in *remoteaddr) {
     AssertV(err == 0, Core::Thread::GetErrno());
     fState |= kBound;
     fState |= kConnected;
+
+    // accept 得到的 Socket 不经过 Open，需要在这里设置触发模式
+    if (fState & kEdgeTriggeredSocketMode)
+      this->SetMode(true);
   } else {
     fState = 0;
   }
@@ -116,3 +131,50 @@ OS_Error TCPSocket::Connect(UInt32 inRemoteAddr, UInt16 inRemotePort) {
 
 }
 
+OS_Error TCPSocket::SetFastOpenConnect() {
+#if __Linux__
+  int one = 1;
+  int err = ::setsockopt(fFileDesc, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, (char *) &one, sizeof(int));
+  if (err == -1)
+    return (OS_Error) Core::Thread::GetErrno();
+  return OS_NoErr;
+#else
+  return (OS_Error) EOPNOTSUPP;
+#endif
+}
+
+OS_Error TCPSocket::ConnectAndSend(UInt32 inRemoteAddr, UInt16 inRemotePort,
+                                   void *inBuffer, UInt32 inLength, UInt32 *outLengthSent) {
+  Assert(outLengthSent != nullptr);
+  *outLengthSent = 0;
+
+#if __Linux__
+  ::memset(&fRemoteAddr, 0, sizeof(fRemoteAddr));
+  fRemoteAddr.sin_family = AF_INET;
+  fRemoteAddr.sin_port = htons(inRemotePort);
+  fRemoteAddr.sin_addr.s_addr = htonl(inRemoteAddr);
+
+  ssize_t theLen;
+  do {
+    theLen = ::sendto(fFileDesc, (char *) inBuffer, inLength, MSG_FASTOPEN,
+                      (sockaddr *) &fRemoteAddr, sizeof(fRemoteAddr));
+  } while (theLen == -1 && Core::Thread::GetErrno() == EINTR);
+
+  if (theLen == -1) {
+    OS_Error theErr = (OS_Error) Core::Thread::GetErrno();
+    if (theErr == EINPROGRESS || theErr == EAGAIN) {
+      fState |= kConnected; // the SYN is out, the same as a pending Connect
+    } else {
+      fRemoteAddr.sin_port = 0;
+      fRemoteAddr.sin_addr.s_addr = 0;
+    }
+    return theErr;
+  }
+
+  fState |= kConnected;
+  *outLengthSent = (UInt32) theLen;
+  return OS_NoErr;
+#else
+  return (OS_Error) EOPNOTSUPP;
+#endif
+}
@@ -33,31 +33,189 @@
 
 using namespace CF::Net;
 
+UDPDemuxer::UDPDemuxer() {
+  for (UInt32 i = 0; i < kNumShards; i++) {
+    fShards[i].fSeq = 0;
+    fShards[i].fTable = newTable(kInitialTableSize);
+    fShards[i].fNumTasks = 0;
+  }
+}
+
+UDPDemuxer::~UDPDemuxer() {
+  for (UInt32 i = 0; i < kNumShards; i++) {
+    Table *theTable = fShards[i].fTable.load();
+    while (theTable != nullptr) {
+      Table *theRetired = theTable->fRetired;
+      delete[] theTable->fEntries;
+      delete theTable;
+      theTable = theRetired;
+    }
+  }
+}
+
+UInt64 UDPDemuxer::hashKey(UInt64 inKey) {
+  // murmur3 finalizer, every input bit affects both the shard and the slot
+  inKey ^= inKey >> 33;
+  inKey *= 0xff51afd7ed558ccdULL;
+  inKey ^= inKey >> 33;
+  inKey *= 0xc4ceb9fe1a85ec53ULL;
+  inKey ^= inKey >> 33;
+  return inKey;
+}
+
+UDPDemuxer::Table *UDPDemuxer::newTable(UInt32 inSize) {
+  auto *theTable = new Table;
+  theTable->fMask = inSize - 1;
+  theTable->fEntries = new Entry[inSize];
+  theTable->fRetired = nullptr;
+  for (UInt32 i = 0; i < inSize; i++) {
+    theTable->fEntries[i].fKey.store(0, std::memory_order_relaxed);
+    theTable->fEntries[i].fTask.store(nullptr, std::memory_order_relaxed);
+  }
+  return theTable;
+}
+
+SInt32 UDPDemuxer::findSlot(Table *inTable, UInt64 inKey, UInt64 inHash) {
+  for (UInt32 i = (UInt32) inHash & inTable->fMask;; i = (i + 1) & inTable->fMask) {
+    UInt64 theKey = inTable->fEntries[i].fKey.load(std::memory_order_relaxed);
+    if (theKey == inKey) return i;
+    if (theKey == 0) return -1;
+  }
+}
+
+void UDPDemuxer::insertSlot(Table *inTable, UInt64 inKey, UInt64 inHash, UDPDemuxerTask *inTaskP) {
+  UInt32 i = (UInt32) inHash & inTable->fMask;
+  while (inTable->fEntries[i].fKey.load(std::memory_order_relaxed) != 0)
+    i = (i + 1) & inTable->fMask;
+  inTable->fEntries[i].fTask.store(inTaskP, std::memory_order_relaxed);
+  inTable->fEntries[i].fKey.store(inKey, std::memory_order_relaxed);
+}
+
+void UDPDemuxer::grow(Shard &ioShard) {
+  Table *theOld = ioShard.fTable.load(std::memory_order_relaxed);
+  Table *theNew = newTable((theOld->fMask + 1) * 2);
+
+  // the new table is private until published, no need to bump fSeq
+  for (UInt32 i = 0; i <= theOld->fMask; i++) {
+    UInt64 theKey = theOld->fEntries[i].fKey.load(std::memory_order_relaxed);
+    if (theKey != 0)
+      insertSlot(theNew, theKey, hashKey(theKey & ~(1ULL << 63)),
+                 theOld->fEntries[i].fTask.load(std::memory_order_relaxed));
+  }
+
+  // lookups may still be reading the old table, keep it until destruction
+  theNew->fRetired = theOld;
+  ioShard.fTable.store(theNew, std::memory_order_release);
+}
+
 OS_Error UDPDemuxer::RegisterTask(UInt32 inRemoteAddr, UInt16 inRemotePort,
                                   UDPDemuxerTask *inTaskP) {
   Assert(nullptr != inTaskP);
-  Core::MutexLocker locker(&fMutex);
-  if (this->GetTask(inRemoteAddr, inRemotePort) != nullptr)
+  UInt64 theKey = makeKey(inRemoteAddr, inRemotePort);
+  UInt64 theHash = hashKey(theKey & ~(1ULL << 63));
+  Shard &theShard = shardFor(theHash);
+
+  Core::MutexLocker locker(&theShard.fMutex);
+  Table *theTable = theShard.fTable.load(std::memory_order_relaxed);
+  if (findSlot(theTable, theKey, theHash) != -1)
     return (OS_Error) EPERM;
-  inTaskP->set(inRemoteAddr, inRemotePort);
-  fHashTable.Add(inTaskP);
+
+  // keep the load factor under 1/2, probes stay short
+  if ((theShard.fNumTasks + 1) * 2 > theTable->fMask + 1) {
+    this->grow(theShard);
+    theTable = theShard.fTable.load(std::memory_order_relaxed);
+  }
+
+  inTaskP->fRemoteAddr = inRemoteAddr;
+  inTaskP->fRemotePort = inRemotePort;
+
+  UInt32 theSeq = theShard.fSeq.load(std::memory_order_relaxed);
+  theShard.fSeq.store(theSeq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  insertSlot(theTable, theKey, theHash, inTaskP);
+  theShard.fSeq.store(theSeq + 2, std::memory_order_release);
+
+  theShard.fNumTasks++;
   return OS_NoErr;
 }
 
 OS_Error UDPDemuxer::UnregisterTask(UInt32 inRemoteAddr, UInt16 inRemotePort,
                                     UDPDemuxerTask *inTaskP) {
-  Core::MutexLocker locker(&fMutex);
-  //remove by executing a lookup based on key information
-  UDPDemuxerTask *theTask = this->GetTask(inRemoteAddr, inRemotePort);
-
-  if ((nullptr != theTask) && (theTask == inTaskP)) {
-    fHashTable.Remove(theTask);
-    return OS_NoErr;
-  } else
+  UInt64 theKey = makeKey(inRemoteAddr, inRemotePort);
+  UInt64 theHash = hashKey(theKey & ~(1ULL << 63));
+  Shard &theShard = shardFor(theHash);
+
+  Core::MutexLocker locker(&theShard.fMutex);
+  Table *theTable = theShard.fTable.load(std::memory_order_relaxed);
+  SInt32 theSlot = findSlot(theTable, theKey, theHash);
+  if (theSlot == -1 ||
+      theTable->fEntries[theSlot].fTask.load(std::memory_order_relaxed) != inTaskP)
     return (OS_Error) EPERM;
+
+  UInt32 theSeq = theShard.fSeq.load(std::memory_order_relaxed);
+  theShard.fSeq.store(theSeq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  // backward shift deletion: move later entries of the probe run into the
+  // hole, so lookups never need tombstones
+  Entry *theEntries = theTable->fEntries;
+  UInt32 theHole = (UInt32) theSlot;
+  for (UInt32 i = (theHole + 1) & theTable->fMask;; i = (i + 1) & theTable->fMask) {
+    UInt64 theNextKey = theEntries[i].fKey.load(std::memory_order_relaxed);
+    if (theNextKey == 0) break;
+
+    UInt32 theHome = (UInt32) hashKey(theNextKey & ~(1ULL << 63)) & theTable->fMask;
+    // the entry may move to the hole if its home is not in (hole, i]
+    if (((i - theHome) & theTable->fMask) >= ((i - theHole) & theTable->fMask)) {
+      theEntries[theHole].fTask.store(theEntries[i].fTask.load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+      theEntries[theHole].fKey.store(theNextKey, std::memory_order_relaxed);
+      theHole = i;
+    }
+  }
+  theEntries[theHole].fKey.store(0, std::memory_order_relaxed);
+  theEntries[theHole].fTask.store(nullptr, std::memory_order_relaxed);
+
+  theShard.fSeq.store(theSeq + 2, std::memory_order_release);
+
+  theShard.fNumTasks--;
+  return OS_NoErr;
 }
 
 UDPDemuxerTask *UDPDemuxer::GetTask(UInt32 inRemoteAddr, UInt16 inRemotePort) {
-  UDPDemuxerKey theKey(inRemoteAddr, inRemotePort);
-  return fHashTable.Map(&theKey);
+  UInt64 theKey = makeKey(inRemoteAddr, inRemotePort);
+  UInt64 theHash = hashKey(theKey & ~(1ULL << 63));
+  Shard &theShard = shardFor(theHash);
+
+  for (;;) {
+    UInt32 theSeq = theShard.fSeq.load(std::memory_order_acquire);
+    if (theSeq & 1) continue; // a writer is in the middle of a change
+
+    Table *theTable = theShard.fTable.load(std::memory_order_acquire);
+    UDPDemuxerTask *theTask = nullptr;
+
+    // bounded, a torn read can't make us spin over a full table
+    UInt32 i = (UInt32) theHash & theTable->fMask;
+    for (UInt32 n = 0; n <= theTable->fMask; n++, i = (i + 1) & theTable->fMask) {
+      UInt64 theEntryKey = theTable->fEntries[i].fKey.load(std::memory_order_relaxed);
+      if (theEntryKey == theKey) {
+        theTask = theTable->fEntries[i].fTask.load(std::memory_order_relaxed);
+        break;
+      }
+      if (theEntryKey == 0) break;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (theShard.fSeq.load(std::memory_order_relaxed) == theSeq)
+      return theTask;
+  }
+}
+
+UInt32 UDPDemuxer::GetNumTasks() {
+  UInt32 theNumTasks = 0;
+  for (UInt32 i = 0; i < kNumShards; i++) {
+    Core::MutexLocker locker(&fShards[i].fMutex);
+    theNumTasks += fShards[i].fNumTasks;
+  }
+  return theNumTasks;
 }
@@ -48,6 +48,20 @@
 #endif
 #endif
 
+#if __Linux__
+#include <netinet/udp.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // linux 4.18
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104     // linux 5.0
+#endif
+#endif
+
 #ifdef USE_NETLOG
 #include <netlog.h>
 #endif
@@ -55,7 +69,7 @@
 using namespace CF::Net;
 
 UDPSocket::UDPSocket(CF::Thread::Task *inTask, UInt32 inSocketType)
-    : Socket(inTask, inSocketType), fDemuxer(nullptr) {
+    : Socket(inTask, inSocketType), fDemuxer(nullptr), fSegmentOffload(false) {
   if (inSocketType & kWantsDemuxer)
     fDemuxer = new UDPDemuxer();
 
@@ -63,6 +77,21 @@ UDPSocket::UDPSocket(CF::Thread::Task *inTask, UInt32 inSocketType)
   ::memset(&fMsgAddr, 0, sizeof(fMsgAddr));
 }
 
+OS_Error UDPSocket::Open() {
+  OS_Error theErr = Socket::Open(SOCK_DGRAM);
+  if (theErr != OS_NoErr)
+    return theErr;
+
+#if __Linux__
+  // a segment size of 0 changes nothing, kernels without UDP_SEGMENT
+  // answer ENOPROTOOPT
+  int theSize = 0;
+  fSegmentOffload = ::setsockopt(fFileDesc, SOL_UDP, UDP_SEGMENT,
+                                 (char *) &theSize, sizeof(theSize)) == 0;
+#endif
+  return OS_NoErr;
+}
+
 OS_Error
 UDPSocket::SendTo(UInt32 inRemoteAddr, UInt16 inRemotePort,
                   void *inBuffer, UInt32 inLength) {
@@ -121,6 +150,229 @@ UDPSocket::RecvFrom(UInt32 *outRemoteAddr, UInt16 *outRemotePort,
   return OS_NoErr;
 }
 
+OS_Error UDPSocket::SendToBatch(Datagram *inDatagrams, UInt32 inNumDatagrams,
+                                UInt32 *outNumSent) {
+  Assert(inDatagrams != nullptr);
+  Assert(outNumSent != nullptr);
+  *outNumSent = 0;
+
+#if __Linux__
+  struct mmsghdr theMsgs[kMaxBatchSize];
+  struct iovec theVecs[kMaxBatchSize];
+  struct sockaddr_in theAddrs[kMaxBatchSize];
+  alignas(struct cmsghdr) char theControls[kMaxBatchSize][CMSG_SPACE(sizeof(UInt16))];
+  bool theIsLastPiece[kMaxBatchSize];
+
+  UInt32 theDatagramIndex[kMaxBatchSize];
+
+  UInt32 theNext = 0;   // next datagram to queue
+  UInt32 theOffset = 0; // bytes of theNext already queued, when splitting
+  while (theNext < inNumDatagrams) {
+    UInt32 theBatchStart = theNext;
+    UInt32 theBatchOffset = theOffset;
+    bool hasSegments = false;
+
+    UInt32 theNumMsgs = 0;
+    while (theNumMsgs < kMaxBatchSize && theNext < inNumDatagrams) {
+      Datagram &theDatagram = inDatagrams[theNext];
+      UInt32 theLen = theDatagram.fLength - theOffset;
+      bool isSegmented = theDatagram.fSegmentSize != 0 && theLen > theDatagram.fSegmentSize;
+      bool canOffload = fSegmentOffload && theLen <= kMaxOffloadLength &&
+          theLen <= (UInt32) theDatagram.fSegmentSize * kMaxOffloadSegments;
+      if (isSegmented && !canOffload) theLen = theDatagram.fSegmentSize;
+
+      struct sockaddr_in &theAddr = theAddrs[theNumMsgs];
+      ::memset(&theAddr, 0, sizeof(theAddr));
+      theAddr.sin_family = AF_INET;
+      theAddr.sin_port = htons(theDatagram.fRemotePort);
+      theAddr.sin_addr.s_addr = htonl(theDatagram.fRemoteAddr);
+
+      theVecs[theNumMsgs].iov_base = (char *) theDatagram.fBuffer + theOffset;
+      theVecs[theNumMsgs].iov_len = theLen;
+
+      struct msghdr &theHdr = theMsgs[theNumMsgs].msg_hdr;
+      ::memset(&theHdr, 0, sizeof(theHdr));
+      theHdr.msg_name = &theAddr;
+      theHdr.msg_namelen = sizeof(theAddr);
+      theHdr.msg_iov = &theVecs[theNumMsgs];
+      theHdr.msg_iovlen = 1;
+
+      if (isSegmented && canOffload) {
+        // one sendmmsg entry, the kernel (or the NIC) cuts the segments
+        theHdr.msg_control = theControls[theNumMsgs];
+        theHdr.msg_controllen = sizeof(theControls[theNumMsgs]);
+        struct cmsghdr *theCmsg = CMSG_FIRSTHDR(&theHdr);
+        theCmsg->cmsg_level = SOL_UDP;
+        theCmsg->cmsg_type = UDP_SEGMENT;
+        theCmsg->cmsg_len = CMSG_LEN(sizeof(UInt16));
+        ::memcpy(CMSG_DATA(theCmsg), &theDatagram.fSegmentSize, sizeof(UInt16));
+        hasSegments = true;
+      }
+
+      theDatagramIndex[theNumMsgs] = theNext;
+      theOffset += theLen;
+      theIsLastPiece[theNumMsgs] = theOffset >= theDatagram.fLength;
+      if (theIsLastPiece[theNumMsgs]) {
+        theNext++;
+        theOffset = 0;
+      }
+      theNumMsgs++;
+    }
+
+    int theNumSent;
+    do {
+      theNumSent = ::sendmmsg(fFileDesc, theMsgs, theNumMsgs, 0);
+    } while (theNumSent == -1 && Core::Thread::GetErrno() == EINTR);
+
+    if (theNumSent == -1) {
+      int theErr = Core::Thread::GetErrno();
+      if (hasSegments && (theErr == EIO || theErr == ENOPROTOOPT)) {
+        // the device can't checksum the segments, split in user space
+        fSegmentOffload = false;
+        theNext = theBatchStart;
+        theOffset = theBatchOffset;
+        continue;
+      }
+      // the pieces of an earlier batch are out
+      if (theBatchOffset > 0)
+        advanceDatagram(&inDatagrams[theBatchStart], theBatchOffset);
+      return *outNumSent > 0 || theBatchOffset > 0 ? OS_NoErr : (OS_Error) theErr;
+    }
+
+    for (int i = 0; i < theNumSent; i++)
+      if (theIsLastPiece[i]) (*outNumSent)++;
+
+    if ((UInt32) theNumSent < theNumMsgs) {
+      // Socket buffer is full, maybe in the middle of a split datagram
+      if (theNumSent > 0 && !theIsLastPiece[theNumSent - 1]) {
+        Datagram &theDatagram = inDatagrams[theDatagramIndex[theNumSent - 1]];
+        struct iovec &theVec = theVecs[theNumSent - 1];
+        advanceDatagram(&theDatagram, (UInt32) ((char *) theVec.iov_base + theVec.iov_len
+            - (char *) theDatagram.fBuffer));
+      } else if (theNumSent == 0 && theBatchOffset > 0) {
+        advanceDatagram(&inDatagrams[theBatchStart], theBatchOffset);
+      }
+      return OS_NoErr;
+    }
+  }
+  return OS_NoErr;
+#else
+  return this->sendToBatchSlow(inDatagrams, inNumDatagrams, outNumSent);
+#endif
+}
+
+OS_Error UDPSocket::sendToBatchSlow(Datagram *inDatagrams, UInt32 inNumDatagrams,
+                                    UInt32 *outNumSent) {
+  for (UInt32 i = 0; i < inNumDatagrams; i++) {
+    Datagram &theDatagram = inDatagrams[i];
+    UInt32 theSegmentSize = theDatagram.fSegmentSize != 0
+                            ? theDatagram.fSegmentSize : theDatagram.fLength;
+    UInt32 theOffset = 0;
+    do {
+      UInt32 theLen = theDatagram.fLength - theOffset;
+      if (theLen > theSegmentSize) theLen = theSegmentSize;
+      OS_Error theErr = this->SendTo(theDatagram.fRemoteAddr, theDatagram.fRemotePort,
+                                     (char *) theDatagram.fBuffer + theOffset, theLen);
+      if (theErr != OS_NoErr) {
+        if (theOffset > 0)
+          advanceDatagram(&theDatagram, theOffset);
+        return *outNumSent > 0 || theOffset > 0 ? OS_NoErr : theErr;
+      }
+      theOffset += theLen;
+    } while (theOffset < theDatagram.fLength);
+    (*outNumSent)++;
+  }
+  return OS_NoErr;
+}
+
+void UDPSocket::advanceDatagram(Datagram *ioDatagram, UInt32 inSent) {
+  Assert(inSent < ioDatagram->fLength);
+  ioDatagram->fBuffer = (char *) ioDatagram->fBuffer + inSent;
+  ioDatagram->fLength -= inSent;
+}
+
+OS_Error UDPSocket::RecvFromBatch(Datagram *ioDatagrams, UInt32 inNumDatagrams,
+                                  UInt32 *outNumRecv) {
+  Assert(ioDatagrams != nullptr);
+  Assert(outNumRecv != nullptr);
+  *outNumRecv = 0;
+
+#if __Linux__
+  struct mmsghdr theMsgs[kMaxBatchSize];
+  struct iovec theVecs[kMaxBatchSize];
+  struct sockaddr_in theAddrs[kMaxBatchSize];
+  alignas(struct cmsghdr) char theControls[kMaxBatchSize][CMSG_SPACE(sizeof(int))];
+
+  UInt32 theNumMsgs = inNumDatagrams < (UInt32) kMaxBatchSize ? inNumDatagrams : (UInt32) kMaxBatchSize;
+  for (UInt32 i = 0; i < theNumMsgs; i++) {
+    theVecs[i].iov_base = ioDatagrams[i].fBuffer;
+    theVecs[i].iov_len = ioDatagrams[i].fBufferSize;
+
+    struct msghdr &theHdr = theMsgs[i].msg_hdr;
+    ::memset(&theHdr, 0, sizeof(theHdr));
+    theHdr.msg_name = &theAddrs[i];
+    theHdr.msg_namelen = sizeof(theAddrs[i]);
+    theHdr.msg_iov = &theVecs[i];
+    theHdr.msg_iovlen = 1;
+    theHdr.msg_control = theControls[i];
+    theHdr.msg_controllen = sizeof(theControls[i]);
+  }
+
+  // MSG_WAITFORONE: only the first datagram may block
+  int theNumRecv;
+  do {
+    theNumRecv = ::recvmmsg(fFileDesc, theMsgs, theNumMsgs, MSG_WAITFORONE, nullptr);
+  } while (theNumRecv == -1 && Core::Thread::GetErrno() == EINTR);
+
+  if (theNumRecv == -1)
+    return (OS_Error) Core::Thread::GetErrno();
+
+  for (int i = 0; i < theNumRecv; i++) {
+    Datagram &theDatagram = ioDatagrams[i];
+    theDatagram.fRemoteAddr = ntohl(theAddrs[i].sin_addr.s_addr);
+    theDatagram.fRemotePort = ntohs(theAddrs[i].sin_port);
+    theDatagram.fLength = theMsgs[i].msg_len;
+    theDatagram.fSegmentSize = 0;
+
+    struct msghdr &theHdr = theMsgs[i].msg_hdr;
+    for (struct cmsghdr *theCmsg = CMSG_FIRSTHDR(&theHdr); theCmsg != nullptr;
+         theCmsg = CMSG_NXTHDR(&theHdr, theCmsg)) {
+      if (theCmsg->cmsg_level == SOL_UDP && theCmsg->cmsg_type == UDP_GRO) {
+        int theSegmentSize;
+        ::memcpy(&theSegmentSize, CMSG_DATA(theCmsg), sizeof(int));
+        theDatagram.fSegmentSize = (UInt16) theSegmentSize;
+      }
+    }
+  }
+  *outNumRecv = (UInt32) theNumRecv;
+  return OS_NoErr;
+#else
+  for (UInt32 i = 0; i < inNumDatagrams; i++) {
+    Datagram &theDatagram = ioDatagrams[i];
+    OS_Error theErr = this->RecvFrom(&theDatagram.fRemoteAddr, &theDatagram.fRemotePort,
+                                     theDatagram.fBuffer, theDatagram.fBufferSize,
+                                     &theDatagram.fLength);
+    if (theErr != OS_NoErr)
+      return *outNumRecv > 0 ? OS_NoErr : theErr;
+    theDatagram.fSegmentSize = 0;
+    (*outNumRecv)++;
+  }
+  return OS_NoErr;
+#endif
+}
+
+OS_Error UDPSocket::SetReceiveOffload(bool inEnable) {
+#if __Linux__
+  int theValue = inEnable ? 1 : 0;
+  int err = ::setsockopt(fFileDesc, SOL_UDP, UDP_GRO, (char *) &theValue, sizeof(theValue));
+  if (err == -1)
+    return (OS_Error) Core::Thread::GetErrno();
+  return OS_NoErr;
+#else
+  return inEnable ? (OS_Error) ENOPROTOOPT : OS_NoErr;
+#endif
+}
+
 OS_Error UDPSocket::JoinMulticast(UInt32 inRemoteAddr) {
   struct ip_mreq theMulti;
   UInt32 localAddr = fLocalAddr.sin_addr.s_addr; // Already in network byte order
@@ -32,110 +32,247 @@
 #include <CF/Net/Socket/UDPSocketPool.h>
 #include <CF/Net/Socket/SocketUtils.h>
 
+#include <string.h>
+
+#if _MSC_VER
+#include <intrin.h>
+#endif
+
 using namespace CF::Net;
 
-/**
- * 获取 UDPSocket Pair
- * @param inIPAddr  local ip
- * @param inPort    local port
- * @param inSrcIPAddr  remote ip
- * @param inSrcPort    remote port
- */
-UDPSocketPair *UDPSocketPool::GetUDPSocketPair(UInt32 inIPAddr, UInt16 inPort, UInt32 inSrcIPAddr, UInt16 inSrcPort) {
-  Core::MutexLocker locker(&fMutex);
-  if ((inSrcIPAddr != 0) || (inSrcPort != 0)) {
-    /* If we find a pair that is:
-     *   a) on the right IP address,
-     *   b) doesn't have this source IP & port in the demuxer already,
-     * we can return this pair */
-    for (QueueIter qIter(&fUDPQueue); !qIter.IsDone(); qIter.Next()) {
-      auto theElem = (UDPSocketPair *) qIter.GetCurrent()->GetEnclosingObject();
-      if ((theElem->fSocketA->GetLocalAddr() == inIPAddr) &&
-          ((inPort == 0) || (theElem->fSocketA->GetLocalPort() == inPort))) {
-        // check to make sure this source IP & port is not already in the demuxer.
-        // If not, we can return this Socket pair.
-        if ((theElem->fSocketB->GetDemuxer() == nullptr) ||
-            ((!theElem->fSocketB->GetDemuxer()->AddrInMap(0, 0)) &&
-                (!theElem->fSocketB->GetDemuxer()->AddrInMap(inSrcIPAddr, inSrcPort)))) {
-          theElem->fRefCount++;
-          return theElem;
-        }
+static inline UInt32 LowestBit(UInt64 inWord) {
+#if _MSC_VER
+  unsigned long theIndex;
+  _BitScanForward64(&theIndex, inWord);
+  return theIndex;
+#else
+  return (UInt32) __builtin_ctzll(inWord);
+#endif
+}
 
-        // If port is specified, there is NO WAY a Socket pair can exist that matches
-        // the criteria (because caller wants a specific ip & port combination)
-        if (inPort != 0)
-          return nullptr;
+UDPSocketPool::UDPSocketPool() {
+  for (UInt32 i = 0; i < kNumShards; i++)
+    fShards[i].fPools = nullptr;
+}
+
+UDPSocketPool::~UDPSocketPool() {
+  // the pairs themselves must have been released by now
+  for (UInt32 i = 0; i < kNumShards; i++) {
+    AddrPool *thePool = fShards[i].fPools;
+    while (thePool != nullptr) {
+      AddrPool *theNext = thePool->fNext;
+      delete[] thePool->fBySlot;
+      delete thePool;
+      thePool = theNext;
+    }
+  }
+}
+
+SInt32 UDPSocketPool::portToSlot(UInt16 inPort) {
+  if (inPort < kLowestUDPPort || ((inPort - kLowestUDPPort) & 1) != 0)
+    return -1;
+  UInt32 theSlot = (UInt32) (inPort - kLowestUDPPort) / 2;
+  return theSlot < kNumPortSlots ? (SInt32) theSlot : -1;
+}
+
+UDPSocketPool::Shard &UDPSocketPool::shardFor(UInt32 inAddr) {
+  // a few addresses at most, spread them with a multiplicative hash
+  return fShards[(inAddr * 2654435761U) >> 29 & (kNumShards - 1)];
+}
+
+UDPSocketPool::AddrPool *UDPSocketPool::getAddrPool(Shard &ioShard, UInt32 inAddr) {
+  for (AddrPool *thePool = ioShard.fPools; thePool != nullptr; thePool = thePool->fNext)
+    if (thePool->fAddr == inAddr) return thePool;
+
+  auto *thePool = new AddrPool;
+  thePool->fAddr = inAddr;
+  thePool->fBySlot = new UDPSocketPair *[kNumPortSlots];
+  ::memset(thePool->fBySlot, 0, kNumPortSlots * sizeof(UDPSocketPair *));
+  ::memset(thePool->fInUse, 0, sizeof(thePool->fInUse));
+  ::memset(thePool->fForeign, 0, sizeof(thePool->fForeign));
+  // bits past the last slot are never free
+  if (kNumPortSlots % 64 != 0)
+    thePool->fInUse[kNumBitmapWords - 1] = ~0ULL << (kNumPortSlots % 64);
+  thePool->fHint = 0;
+
+  thePool->fNext = ioShard.fPools;
+  ioShard.fPools = thePool;
+  return thePool;
+}
+
+SInt32 UDPSocketPool::allocSlot(AddrPool *ioPool) {
+  for (int theRound = 0; theRound < 2; theRound++) {
+    for (UInt32 n = 0; n < kNumBitmapWords; n++) {
+      UInt32 theWord = (ioPool->fHint + n) % kNumBitmapWords;
+      UInt64 theFree = ~(ioPool->fInUse[theWord] | ioPool->fForeign[theWord]);
+      if (theFree != 0) {
+        ioPool->fHint = theWord;
+        return (SInt32) (theWord * 64 + LowestBit(theFree));
       }
     }
+
+    // every port is taken, ports other processes held may be free by now
+    ::memset(ioPool->fForeign, 0, sizeof(ioPool->fForeign));
   }
+  return -1;
+}
 
-  // if we get here, there is no pair already in the pool that matches the specified
-  // criteria, so we have to create a new pair.
-  return this->CreateUDPSocketPair(inIPAddr, inPort);
+OS_Error UDPSocketPool::bindPair(UInt32 inAddr, UInt16 inPort, UDPSocketPair **outPair) {
+  *outPair = nullptr;
+
+  UDPSocketPair *thePair = ConstructUDPSocketPair();  // 创建一个 udp Socket pair
+  Assert(thePair != nullptr);
+
+  // check construct udp socket pair fail
+  if (thePair == nullptr) return (OS_Error) ENOMEM;
+
+  // 创建数据报 Socket 端口
+  OS_Error theErr = thePair->fSocketA->Open();
+  if (theErr == OS_NoErr) theErr = thePair->fSocketB->Open();
+  if (theErr == OS_NoErr) {
+    // Set Socket options on these new sockets. 主要是设置 Socket buf size
+    this->SetUDPSocketOptions(thePair);
+
+    // 在两个 Socket 端口上执行 bind 操作,两个 port 相差 1.
+    theErr = thePair->fSocketA->Bind(inAddr, inPort);
+    if (theErr == OS_NoErr)
+      theErr = thePair->fSocketB->Bind(inAddr, static_cast<UInt16>(inPort + 1));
+  }
+
+  if (theErr != OS_NoErr) {
+    this->DestructUDPSocketPair(thePair);
+    return theErr;
+  }
+
+  *outPair = thePair;
+  return OS_NoErr;
 }
 
-void UDPSocketPool::ReleaseUDPSocketPair(UDPSocketPair *inPair) {
-  Core::MutexLocker locker(&fMutex);
-  inPair->fRefCount--;
-  if (inPair->fRefCount == 0) {
-    fUDPQueue.Remove(&inPair->fElem);
-    this->DestructUDPSocketPair(inPair);
+void UDPSocketPool::addPair(AddrPool *ioPool, UDPSocketPair *inPair, SInt32 inSlot) {
+  inPair->fPoolAddr = ioPool->fAddr;
+  inPair->fSlot = inSlot;
+  inPair->fRefCount = 1;
+  if (inSlot >= 0) {
+    ioPool->fInUse[inSlot / 64] |= 1ULL << (inSlot % 64);
+    ioPool->fBySlot[inSlot] = inPair;
   }
+  ioPool->fPairs.EnQueue(&inPair->fElem);
 }
 
-UDPSocketPair *UDPSocketPool::CreateUDPSocketPair(UInt32 inAddr, UInt16 inPort) {
-  // try to find an open pair of ports to bind these suckers tooo
-  Core::MutexLocker locker(&fMutex);
+UDPSocketPair *UDPSocketPool::createPair(AddrPool *ioPool, UInt32 inAddr, UInt16 inPort) {
   UDPSocketPair *thePair = nullptr;
-  UInt16 socketAPort = kLowestUDPPort;
-  UInt16 socketBPort;
 
   // If port is 0, then the caller doesn't care what port # we bind this Socket to.
   // Otherwise, ONLY attempt to bind this Socket to the specified port
-  if (inPort != 0) socketAPort = inPort;
+  if (inPort != 0) {
+    if (this->bindPair(inAddr, inPort, &thePair) != OS_NoErr)
+      return nullptr;
+    this->addPair(ioPool, thePair, portToSlot(inPort));
+    return thePair;
+  }
 
-  while (socketAPort < kHighestUDPPort) {
-    socketBPort = static_cast<UInt16>(socketAPort + 1);  // make Socket pairs adjacent to one another
+  for (;;) {
+    SInt32 theSlot = this->allocSlot(ioPool);
+    if (theSlot < 0) return nullptr;
 
-    thePair = ConstructUDPSocketPair();  // 创建一个 udp Socket pair
-    Assert(thePair != nullptr);
+    OS_Error theErr = this->bindPair(inAddr, slotToPort((UInt32) theSlot), &thePair);
+    if (theErr == OS_NoErr) {
+      this->addPair(ioPool, thePair, theSlot);
+      return thePair;
+    }
 
-    // check construct udp socket pair fail
-    if (thePair == nullptr) return nullptr;
+    // out of descriptors or the like, another port won't help
+    if (theErr != EADDRINUSE && theErr != EACCES)
+      return nullptr;
 
-    // 创建数据报 Socket 端口
-    if (thePair->fSocketA->Open() != OS_NoErr || thePair->fSocketB->Open() != OS_NoErr) break;
+    ioPool->fForeign[theSlot / 64] |= 1ULL << (theSlot % 64);
+  }
+}
 
-    // Set Socket options on these new sockets. 主要是设置 Socket buf size
-    this->SetUDPSocketOptions(thePair);
+bool UDPSocketPool::isReusable(UDPSocketPair *inPair, UInt32 inSrcIPAddr, UInt16 inSrcPort) {
+  // check to make sure this source IP & port is not already in the demuxer.
+  UDPDemuxer *theDemuxer = inPair->fSocketB->GetDemuxer();
+  return (theDemuxer == nullptr) ||
+      ((!theDemuxer->AddrInMap(0, 0)) && (!theDemuxer->AddrInMap(inSrcIPAddr, inSrcPort)));
+}
 
-    // 在两个 Socket 端口上执行 bind 操作,两个 port 相差 1.
-    OS_Error theErr = thePair->fSocketA->Bind(inAddr, socketAPort);
-    if (theErr == OS_NoErr) {
-      //s_printf("fSocketA->Bind ok on port%u\n", socketAPort);
-      theErr = thePair->fSocketB->Bind(inAddr, socketBPort);
-      if (theErr == OS_NoErr) {
-        //s_printf("fSocketB->Bind ok on port%u\n", socketBPort);
-        fUDPQueue.EnQueue(&thePair->fElem);
-        thePair->fRefCount++;
+/**
+ * 获取 UDPSocket Pair
+ * @param inIPAddr  local ip
+ * @param inPort    local port
+ * @param inSrcIPAddr  remote ip
+ * @param inSrcPort    remote port
+ */
+UDPSocketPair *UDPSocketPool::GetUDPSocketPair(UInt32 inIPAddr, UInt16 inPort, UInt32 inSrcIPAddr, UInt16 inSrcPort) {
+  Shard &theShard = shardFor(inIPAddr);
+  Core::MutexLocker locker(&theShard.fMutex);
+  AddrPool *thePool = this->getAddrPool(theShard, inIPAddr);
+
+  if ((inSrcIPAddr != 0) || (inSrcPort != 0)) {
+    if (inPort != 0) {
+      // If port is specified, there is NO WAY another Socket pair can match
+      // the criteria (because caller wants a specific ip & port combination)
+      UDPSocketPair *thePair = nullptr;
+      SInt32 theSlot = portToSlot(inPort);
+      if (theSlot >= 0) {
+        thePair = thePool->fBySlot[theSlot];
+      } else {
+        // not on a slot boundary, these are rare
+        for (QueueIter qIter(&thePool->fPairs); !qIter.IsDone(); qIter.Next()) {
+          auto theElem = (UDPSocketPair *) qIter.GetCurrent()->GetEnclosingObject();
+          if (theElem->fSocketA->GetLocalPort() == inPort) {
+            thePair = theElem;
+            break;
+          }
+        }
+      }
 
+      if (thePair != nullptr) {
+        if (!isReusable(thePair, inSrcIPAddr, inSrcPort))
+          return nullptr;
+        thePair->fRefCount++;
         return thePair;
       }
-      //else s_printf("fSocketB->Bind failed on port%u\n", socketBPort);
+    } else {
+      /* Look at a few pairs from the head of the queue, and move each one to
+       * the tail, so that the next request starts with other pairs and the
+       * load spreads over the pool. */
+      UInt32 theNumProbes = thePool->fPairs.GetLength();
+      if (theNumProbes > kMaxReuseProbes) theNumProbes = kMaxReuseProbes;
+      for (UInt32 i = 0; i < theNumProbes; i++) {
+        QueueElem *theElem = thePool->fPairs.DeQueue();
+        thePool->fPairs.EnQueue(theElem);
+        auto *thePair = (UDPSocketPair *) theElem->GetEnclosingObject();
+        if (isReusable(thePair, inSrcIPAddr, inSrcPort)) {
+          thePair->fRefCount++;
+          return thePair;
+        }
+      }
     }
-    //else s_printf("fSocketA->Bind failed on port%u\n", socketAPort);
-
-    // If we are looking to bind to a specific port set, and we couldn't then just break here.
-    if (inPort != 0) break;
+  }
 
-    socketAPort += 2; //try a higher port pair
+  // if we get here, there is no pair already in the pool that matches the specified
+  // criteria, so we have to create a new pair.
+  return this->createPair(thePool, inIPAddr, inPort);
+}
 
-    this->DestructUDPSocketPair(thePair); //a bind failure
-    thePair = nullptr;
+void UDPSocketPool::ReleaseUDPSocketPair(UDPSocketPair *inPair) {
+  Shard &theShard = shardFor(inPair->fPoolAddr);
+  Core::MutexLocker locker(&theShard.fMutex);
+  inPair->fRefCount--;
+  if (inPair->fRefCount == 0) {
+    AddrPool *thePool = this->getAddrPool(theShard, inPair->fPoolAddr);
+    thePool->fPairs.Remove(&inPair->fElem);
+    if (inPair->fSlot >= 0) {
+      thePool->fInUse[inPair->fSlot / 64] &= ~(1ULL << (inPair->fSlot % 64));
+      thePool->fBySlot[inPair->fSlot] = nullptr;
+    }
+    this->DestructUDPSocketPair(inPair);
   }
+}
 
-  // if we couldn't find a pair of sockets, make sure to clean up our mess
-  if (thePair != nullptr) this->DestructUDPSocketPair(thePair);
-
-  return nullptr;
+UDPSocketPair *UDPSocketPool::CreateUDPSocketPair(UInt32 inAddr, UInt16 inPort) {
+  Shard &theShard = shardFor(inAddr);
+  Core::MutexLocker locker(&theShard.fMutex);
+  return this->createPair(this->getAddrPool(theShard, inAddr), inAddr, inPort);
 }
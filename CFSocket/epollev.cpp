@@ -1,10 +1,12 @@
 #include <sys/errno.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <map>
 
 #include <CF/Core/SpinLock.h>
 #include <CF/Core/Thread.h>
+#include <CF/Core/Time.h>
 #include <CF/Net/ev.h>
 
 /* epoll pool size */
@@ -12,15 +14,22 @@
 #define MAX_EPOLL_FD 20000
 #endif
 
+/* max PAUSE count between two polls in busy-poll mode */
+#ifndef MAX_BUSY_POLL_BACKOFF
+#define MAX_BUSY_POLL_BACKOFF 64
+#endif
+
 using namespace CF::Core;
 
 static int gEpollFD = -1;                // epoll 描述符
+static int gWakeupFD = -1;               // eventfd, select_wakeup 写入以打断 epoll_wait
 static epoll_event *gEpollEvents = NULL; // epoll 事件接收数组
 static int gCurEventReadPos = 0;         // 当前读事件位置，在epoll事件数组中的位置
 static int gCurTotalEvents = 0;          // 总的事件个数，每次epoll_wait之后更新
 static std::map<int, void *> gDataMap;   // 映射 fd和对应的RTSPSession对象
 static SpinLock sMapLock;                // epollFDMap 自旋锁
 static SpinLock sArrayLock;              // _events 自旋锁
+static UInt32 gBusyPollUSec = 0;         // busy-poll 时长，0 表示关闭
 
 /*
  * epoll event:
@@ -53,11 +62,29 @@ void select_startevents() {
     }
   }
 
+  if (gWakeupFD == -1) {
+    gWakeupFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (gWakeupFD == -1) {
+      perror("create gWakeupFD error: ");
+      exit(-1);
+    }
+
+    struct epoll_event ev;
+    ev.data.fd = gWakeupFD;
+    ev.events = EPOLLIN;
+    epoll_ctl(gEpollFD, EPOLL_CTL_ADD, gWakeupFD, &ev);
+  }
+
   gCurEventReadPos = 0;
   gCurTotalEvents = 0;
 }
 
 void select_stopevents() {
+  if (gWakeupFD != -1) {
+    ::close(gWakeupFD);
+    gWakeupFD = -1;
+  }
+
   if (gEpollFD != -1) {
     ::close(gEpollFD); /* 关闭文件描述符 */
     gEpollFD = -1;
@@ -67,27 +94,49 @@ void select_stopevents() {
   gEpollEvents = NULL;
 }
 
-int select_modwatch0(struct eventreq *req, int which, bool isAdd) {
-  if (req == NULL) return -1;
-
-  // 加锁，防止线程池中的多个线程执行该函数，导致插入监听事件失败
-  SpinLocker locker(&sMapLock);
-
-  struct epoll_event ev;
-  ev.data.fd = req->er_handle;
-  ev.events = 0;
+UInt32 epoll_fromeventbits(int which) {
+  UInt32 events = 0;
 
   if (which & EV_ET)
-    ev.events |= EPOLLET;  // Edge Triggered
+    events |= EPOLLET;  // Edge Triggered
 
   if (which & EV_OS)
-    ev.events |= EPOLLONESHOT;  // one shot
+    events |= EPOLLONESHOT;  // one shot
 
   if (which & EV_RE)
-    ev.events |= EPOLLIN | EPOLLHUP | EPOLLERR;
+    events |= EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR;
 
   if (which & EV_WR)
-    ev.events |= EPOLLOUT;
+    events |= EPOLLOUT;
+
+  return events;
+}
+
+int epoll_toeventbits(UInt32 events) {
+  // 一次 epoll 事件可能同时包含多种状态，按位转换，不能按值比较
+  int eventbits = 0;
+  if (events & (EPOLLIN | EPOLLRDHUP))
+    eventbits |= EV_RE; // 对端关闭写端时 read 会返回 0
+  if (events & EPOLLOUT)
+    eventbits |= EV_WR;
+  if (events & EPOLLHUP) {
+    DEBUG_LOG(0, "active hang up event=%u\n", events);
+    eventbits |= EV_RE | EV_HU;
+  }
+  if (events & EPOLLERR)
+    eventbits |= EV_ER; // EventContext::DispatchEvent tells errors from notifications
+  return eventbits;
+}
+
+int select_modwatch0(struct eventreq *req, int which, bool isAdd) {
+  if (req == NULL) return -1;
+
+  // 加锁，防止线程池中的多个线程执行该函数，导致插入监听事件失败
+  SpinLocker locker(&sMapLock);
+
+  struct epoll_event ev;
+  ev.data.fd = req->er_handle;
+  ev.events = epoll_fromeventbits(which);
 
   int ret = -1;
   if (isAdd) {
@@ -98,6 +147,10 @@ int select_modwatch0(struct eventreq *req, int which, bool isAdd) {
     do {
       ret = epoll_ctl(gEpollFD, EPOLL_CTL_MOD, req->er_handle, &ev);
     } while (ret == -1 && Thread::GetErrno() == EINTR);
+
+    // 被 select_removeevent 移除过的 fd(如暂停 accept 的 listener)需要重新添加
+    if (ret == -1 && Thread::GetErrno() == ENOENT)
+      ret = epoll_ctl(gEpollFD, EPOLL_CTL_ADD, req->er_handle, &ev);
   }
 
   if (ret == 0) {
@@ -124,9 +177,39 @@ int select_removeevent(int which) {
   return ret;
 }
 
+void select_wakeup() {
+  (void) eventfd_write(gWakeupFD, 1);
+}
+
+void select_setbusypoll(UInt32 inBusyPollUSec) {
+  gBusyPollUSec = inBusyPollUSec;
+}
+
+/**
+ * busy-poll: 在 gBusyPollUSec 时间内以 0 超时反复 epoll_wait，两次轮询之间
+ * 执行指数增长的 PAUSE，以减少对同核超线程的影响
+ */
+static int epoll_busywait() {
+  SInt64 theDeadline = Time::Microseconds() + gBusyPollUSec;
+  UInt32 theBackoff = 1;
+  do {
+    int theNumEvents = epoll_wait(gEpollFD, gEpollEvents, MAX_EPOLL_FD, 0);
+    if (theNumEvents != 0) return theNumEvents;
+
+    for (UInt32 i = 0; i < theBackoff; i++) CpuRelax();
+    if (theBackoff < MAX_BUSY_POLL_BACKOFF) theBackoff <<= 1;
+  } while (Time::Microseconds() < theDeadline);
+  return 0;
+}
+
 int epoll_waitevent() {
   int curReadPos = -1;
 
+  if (gCurTotalEvents <= 0 && gBusyPollUSec > 0) {
+    gCurTotalEvents = epoll_busywait();
+    gCurEventReadPos = 0;
+  }
+
   if (gCurTotalEvents <= 0) { // 当前一个epoll事件都没有的时候，执行 epoll_wait
     gCurTotalEvents = epoll_wait(gEpollFD, gEpollEvents, MAX_EPOLL_FD, 15000); // 15秒超时
     gCurEventReadPos = 0;
@@ -142,6 +225,10 @@ int epoll_waitevent() {
   return curReadPos;
 }
 
+int select_pendingevents() {
+  return gCurTotalEvents > 0 ? gCurTotalEvents - gCurEventReadPos : 0;
+}
+
 /**
  * 等待事件到来
  *
@@ -151,17 +238,15 @@ int select_waitevent(struct eventreq *req, void *onlyForMOSX) {
   SpinLocker locker(&sArrayLock);
   int eventPos = epoll_waitevent();
   if (eventPos >= 0) {
-    req->er_handle = gEpollEvents[eventPos].data.fd;
-    if (gEpollEvents[eventPos].events == EPOLLIN ||
-        gEpollEvents[eventPos].events == EPOLLHUP ||
-        gEpollEvents[eventPos].events == EPOLLERR) {
-      if (gEpollEvents[eventPos].events != EPOLLIN) {
-        DEBUG_LOG(0, "active non-in event=%u\n", gEpollEvents[eventPos].events);
-      }
-      req->er_eventbits = EV_RE;  // we only support read event
-    } else if (gEpollEvents[eventPos].events == EPOLLOUT) {
-      req->er_eventbits = EV_WR;
+    if (gEpollEvents[eventPos].data.fd == gWakeupFD) {
+      eventfd_t theValue;
+      (void) eventfd_read(gWakeupFD, &theValue);
+      return EINTR;
     }
+
+    req->er_handle = gEpollEvents[eventPos].data.fd;
+
+    req->er_eventbits = epoll_toeventbits(gEpollEvents[eventPos].events);
     SpinLocker locker1(&sMapLock);
     req->er_data = gDataMap[req->er_handle];
     return 0;
@@ -248,6 +248,19 @@ int constructeventreq(struct eventreq *req, int fd, int event) {
   return 0;
 }
 
+void select_setbusypoll(UInt32 /*inBusyPollUSec*/) {
+  // not supported by this implementation
+}
+
+void select_wakeup() {
+  int theErr = ::write(sPipes[1], "p", 1);
+  Assert(theErr == 1);
+}
+
+int select_pendingevents() {
+  return 0; // every wait is accounted as a single event
+}
+
 int select_waitevent(struct eventreq *req, void * /*onlyForMacOSX*/) {
   //Check to see if we still have some select descriptors to process
   int theFDsProcessed = (int) sNumFDsProcessed;
@@ -133,9 +133,23 @@ class TCPClientSocket : public ClientSocket {
 
   virtual UInt16 GetLocalPort() { return fSocket.GetLocalPort(); }
 
+  //
+  // TCP Fast Open: the first SendV carries its data in the SYN. Must be set
+  // before the connection is made. TCP_FASTOPEN_CONNECT is used where the
+  // kernel has it, otherwise sendto(MSG_FASTOPEN); elsewhere it's a normal connect.
+  void SetFastOpen(bool inEnabled) { fFastOpen = inEnabled; }
+  static void SetDefaultFastOpen(bool inEnabled) { sFastOpen = inEnabled; }
+  static bool GetDefaultFastOpen() { return sFastOpen; }
+
  private:
 
+  // connects with fast open, EOPNOTSUPP if it isn't available
+  OS_Error fastOpen();
+
   TCPSocket fSocket;
+  bool fFastOpen;
+
+  static bool sFastOpen;
 };
 
 class HTTPClientSocket : public ClientSocket {
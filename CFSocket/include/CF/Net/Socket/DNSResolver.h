@@ -0,0 +1,172 @@
+/**
+ * @file DNSResolver.h
+ *
+ * 非阻塞的 DNS 解析(A 记录)。
+ *
+ * 查询通过 UDPSocket 发往配置的 DNS 服务器，应答由事件线程投递给解析器
+ * 这个 Task 处理，不会阻塞任何 TaskThread。结果按应答中的 TTL 缓存，
+ * 失败也会短暂缓存；同一名字的并发请求合并为一次查询。请求的 Task 在
+ * 结果可用时收到 kUpdateEvent，再次调用 Resolve 即可从缓存中取得结果。
+ */
+
+#ifndef __CF_NET_DNS_RESOLVER_H__
+#define __CF_NET_DNS_RESOLVER_H__
+
+#include <string.h>
+#include <CF/HashTable.h>
+#include <CF/Queue.h>
+#include <CF/Core/Mutex.h>
+#include <CF/Thread/IdleTask.h>
+#include <CF/Net/Socket/UDPSocket.h>
+
+namespace CF {
+namespace Net {
+
+class DNSResolver : public Thread::IdleTask {
+ public:
+
+  enum {
+    kDefaultServerPort = 53,        //UInt16
+    kMaxNameLength = 253,           //UInt32
+    kRetryTimeoutInMsec = 1000,     //UInt32
+    kMaxAttempts = 3,               //UInt32
+    kNegativeTTLInSec = 5,          //UInt32, NXDOMAIN and server failures
+    kMinTTLInSec = 1,               //UInt32, so that waiters can pick it up
+    kMaxTTLInSec = 3600             //UInt32
+  };
+
+  /**
+   * Creates the global resolver. inServerAddr 0 takes the first nameserver
+   * from /etc/resolv.conf, or 127.0.0.1. Needs the task threads, the idle
+   * task thread and the event thread.
+   */
+  static void Initialize(UInt32 inServerAddr = 0, UInt16 inServerPort = kDefaultServerPort);
+
+  static void Release();
+
+  static DNSResolver *GetResolver() { return sResolver; }
+
+  /**
+   * @param inServerAddr - DNS server, host byte order
+   *
+   * The resolver is a Task: delete it by sending it a kKillEvent.
+   */
+  DNSResolver(UInt32 inServerAddr, UInt16 inServerPort);
+
+  ~DNSResolver() override;
+
+  OS_Error Open();
+
+  /**
+   * @brief 解析 inName 的 IPv4 地址
+   *
+   * 点分十进制的地址直接返回。
+   *
+   * @param outAddr  host byte order
+   * @return OS_NoErr: *outAddr is set;
+   *         EINPROGRESS: inTask gets a kUpdateEvent when the result is in,
+   *           call Resolve again then;
+   *         ENOENT: no such name (or no A record); ETIMEDOUT: no answer from
+   *         the server; EIO: the server failed; EINVAL: bad name
+   */
+  OS_Error Resolve(StrPtrLen const &inName, Thread::Task *inTask, UInt32 *outAddr);
+
+  // Stops notifying inTask, must be called before a waiting task is deleted
+  void Cancel(Thread::Task *inTask);
+
+  UInt32 GetServerAddr() { return fServerAddr; }
+  UInt16 GetServerPort() { return fServerPort; }
+
+ private:
+
+  struct Waiter {
+    Thread::Task *fTask;
+    QueueElem fElem;
+  };
+
+  class Entry {
+   public:
+    Entry(StrPtrLen const &inName, UInt32 inHashValue);
+    ~Entry();
+
+    char fName[kMaxNameLength + 1];   // lower case
+    UInt32 fNameLen;
+
+    // the result, valid when !fPending
+    UInt32 fAddr;
+    OS_Error fErr;
+    SInt64 fExpires;
+
+    // the query in flight
+    bool fPending;
+    UInt16 fQueryID;
+    UInt32 fAttempts;
+    SInt64 fDeadline;
+    Queue fWaiters;
+    QueueElem fPendingElem;
+
+    UInt32 fHashValue;
+    Entry *fNextHashEntry;
+  };
+
+  class EntryKey {
+   public:
+    EntryKey(char const *inName, UInt32 inNameLen, UInt32 inHashValue)
+        : fName(inName), fNameLen(inNameLen), fHashValue(inHashValue) {}
+    explicit EntryKey(Entry *inEntry)
+        : fName(inEntry->fName), fNameLen(inEntry->fNameLen), fHashValue(inEntry->fHashValue) {}
+
+    UInt32 GetHashKey() { return fHashValue; }
+
+    friend int operator==(const EntryKey &key1, const EntryKey &key2) {
+      return key1.fNameLen == key2.fNameLen &&
+          ::memcmp(key1.fName, key2.fName, key1.fNameLen) == 0;
+    }
+
+   private:
+    char const *fName;
+    UInt32 fNameLen;
+    UInt32 fHashValue;
+  };
+
+  typedef HashTable<Entry, EntryKey> EntryTable;
+
+  SInt64 Run() override;
+
+  // These need fMutex
+  // replaces fSocket with one on a new ephemeral port
+  OS_Error openSocket();
+  OS_Error sendQuery(Entry *ioEntry);
+  void processResponse(char *inPacket, UInt32 inLength);
+  void complete(Entry *ioEntry, UInt32 inAddr, OS_Error inErr, UInt32 inTTLInSec);
+  void removeEntry(Entry *inEntry);
+  // retransmits and sweeps, returns msec until the next deadline, 0: none
+  SInt64 checkTimers(SInt64 inNow);
+
+  UInt16 nextQueryID();
+
+  static UInt32 hashName(char const *inName, UInt32 inNameLen);
+  static UInt32 readServerAddr();
+
+  enum {
+    kEntryTableSize = 1021,       //UInt32
+    kMaxPacketSize = 512,         //UInt32, plain UDP DNS
+    kSweepIntervalInMsec = 10000  //UInt32
+  };
+
+  Core::Mutex fMutex;
+  UDPSocket *fSocket;   // renewed for each batch of queries
+  UInt32 fServerAddr;
+  UInt16 fServerPort;
+  EntryTable fEntries;
+  Queue fPending;
+  UInt32 fRandom;
+  SInt64 fNextSweep;
+
+  static DNSResolver *sResolver;
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __CF_NET_DNS_RESOLVER_H__
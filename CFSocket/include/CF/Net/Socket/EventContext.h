@@ -50,6 +50,7 @@
 
 #include <CF/Ref.h>
 #include <CF/Thread/Task.h>
+#include <CF/Net/Socket/EventMetrics.h>
 
 //enable to trace event context execution and the task associated with the context
 #ifndef DEBUG_EVENT_CONTEXT
@@ -63,6 +64,7 @@ namespace CF {
 namespace Net {
 
 class EventThread;
+class EventPoller;
 
 class EventContext {
  public:
@@ -89,12 +91,32 @@ class EventContext {
    */
   void InitNonBlocking(SOCKET inFileDesc);
 
+  /**
+   * @brief 设置事件触发模式
+   *
+   * ET 模式下，fd 在首次 RequestEvent 时同时注册读写事件，且注册是持久的
+   * (不使用 one shot)，此后的 RequestEvent 不再调用 epoll_ctl。
+   * 调用方需要读/写直到 EAGAIN，就绪状态记录在 fReadyBits 中。
+   */
   void SetMode(bool useET) { this->fUseETMode = useET; }
+  bool IsETMode() { return fUseETMode; }
 
   //
   // Arms this EventContext. Pass in the events you would like to receive
   virtual void RequestEvent(UInt32 theMask);
 
+  //
+  // Readiness state for ET mode. The EventThread marks the context ready
+  // when an edge is reported, the I/O path clears it when it hits EAGAIN.
+  bool IsReady(UInt32 theMask) { return (fReadyBits & theMask) != 0; }
+
+  //
+  // The peer has hung up or the Socket has an error pending. This is
+  // recorded in any mode, so the owner can tear down without another read.
+  bool IsHangUp() { return (fReadyBits & EV_HU) != 0; }
+  void SetReady(UInt32 theMask) { fReadyBits |= theMask; }
+  void ClearReady(UInt32 theMask) { fReadyBits &= ~theMask; }
+
   //
   // Provide the task you would like to be notified
   void SetTask(Thread::Task *inTask) {
@@ -109,6 +131,17 @@ class EventContext {
     }
   }
 
+  /**
+   * @brief 将 fd 注册到指定 TaskThread 的轮询器(thread-per-core 模式)
+   *
+   * 必须在第一次 RequestEvent 之前调用，并且 Task 应通过 SetDefaultThread
+   * 绑定到该轮询器所属的线程。
+   */
+  void SetPoller(EventPoller *inPoller) {
+    Assert(!fWatchEventCalled);
+    fPoller = inPoller;
+  }
+
   // when the HTTP Proxy tunnels takes over a TCPSocket, we need to maintain
   // this context too
   void SnarfEventContext(EventContext &fromContext);
@@ -124,6 +157,11 @@ class EventContext {
 
  protected:
 
+  //
+  // Called by the EventThread or EventPoller: records the readiness state,
+  // then calls ProcessEvent
+  void DispatchEvent(int eventBits);
+
   /**
    * @brief process network event on socket
    *
@@ -131,9 +169,11 @@ class EventContext {
    * will get called. Default behavior is to Signal the associated
    * task, but that behavior may be altered / overridden.
    *
-   * Currently, we always generate a Task::kReadEvent
+   * EV_RE generates a Task::kReadEvent, EV_WR generates a Task::kWriteEvent.
+   * EV_HU always comes with EV_RE, so the task reads and sees the error;
+   * it is also recorded in the readiness state, see IsHangUp.
    */
-  virtual void ProcessEvent(int /*eventBits*/) {
+  virtual void ProcessEvent(int eventBits) {
 
     if (fTask == nullptr) {
       DEBUG_LOG(DEBUG_EVENT_CONTEXT, "EventContext@%p::ProcessEvent task=NULL\n", this);
@@ -143,7 +183,23 @@ class EventContext {
     }
 
     if (fTask != nullptr)
-      fTask->Signal(Thread::Task::kReadEvent);
+      fTask->Signal(ToTaskEvents(eventBits));
+  }
+
+  /**
+   * @brief 读取错误队列中的通知
+   *
+   * EV_ER 到达时调用。返回 true 表示读到了通知(不是连接错误)，此时事件
+   * 以 EV_WR 投递；返回 false 时按 EV_HU 处理。
+   */
+  virtual bool ReapErrorQueue() { return false; }
+
+  static Thread::Task::EventFlags ToTaskEvents(UInt32 eventBits) {
+    Thread::Task::EventFlags events = 0;
+    if (eventBits & (EV_RE | EV_HU)) events |= Thread::Task::kReadEvent;
+    if (eventBits & EV_WR) events |= Thread::Task::kWriteEvent;
+    if (events == 0) events = Thread::Task::kReadEvent; // unknown, let the task find out
+    return events;
   }
 
   SOCKET fFileDesc;
@@ -151,12 +207,15 @@ class EventContext {
  private:
   struct eventreq fEventReq;
   bool fUseETMode; // Edge Triggered Mode
+  std::atomic<UInt32> fReadyBits; // ET 模式下的就绪状态, EV_RE | EV_WR
 
   Ref fRef; /* 引用记录，用于 event 调度 */
   PointerSizedInt fUniqueID;
   StrPtrLen fUniqueIDStr;
   EventThread *fEventThread;
+  EventPoller *fPoller; // 非空时由该轮询器而不是 EventThread 监听
   bool fWatchEventCalled;
+  bool fEventRemoved;   // EV_RM took the fd out of the poller
   int fEventBits;
   bool fAutoCleanup;
 
@@ -169,6 +228,7 @@ class EventContext {
   static std::atomic<unsigned int> sUniqueID; // id 分配器
 
   friend class EventThread;
+  friend class EventPoller;
 };
 
 /**
@@ -179,15 +239,27 @@ class EventContext {
 class EventThread : public Core::Thread {
  public:
 
-  EventThread() : Thread() {}
+  EventThread() : Thread(), fBatchStartUSec(0) {}
   ~EventThread() override = default;
 
+  /**
+   * @brief 获取事件循环的统计快照，可在任意线程调用
+   */
+  void GetMetrics(EventMetrics::Snapshot *outSnapshot) {
+    fMetrics.GetSnapshot(outSnapshot);
+  }
+
+  UInt64 GetLagUSec() { return fMetrics.GetLagUSec(); }
+
  private:
 
   void Entry() override;
 
   RefTable fRefTable;
 
+  EventMetrics fMetrics;
+  SInt64 fBatchStartUSec; // 最近一次 wait 返回的时间，用于计算分发延迟
+
   friend class EventContext;
 };
 
@@ -0,0 +1,112 @@
+/**
+ * @file EventMetrics.h
+ *
+ * EventThread 运行状态统计：epoll_wait 阻塞时长、每次唤醒的事件数、
+ * 从就绪到 Task::Signal 的分发延迟、ID 解析失败次数以及注册/修改次数。
+ *
+ * 计数器只增不减，需要速率时对两次快照做差。
+ */
+
+#ifndef __CF_NET_EVENT_METRICS_H__
+#define __CF_NET_EVENT_METRICS_H__
+
+#include <atomic>
+#include <CF/Types.h>
+
+namespace CF {
+namespace Net {
+
+class EventMetrics {
+ public:
+
+  enum {
+    kNumHistogramBuckets = 24   // log2 buckets, the last one is open ended
+  };
+
+  /**
+   * @brief 统计快照
+   *
+   * Histogram bucket i counts samples in [2^i, 2^(i+1)), bucket 0 also
+   * counts 0. Times are in microseconds.
+   */
+  struct Snapshot {
+    SInt64 fSampleTimeMilli;        // when this snapshot was taken
+
+    UInt64 fNumWaits;               // blocking waits on the backend
+    UInt64 fNumEmptyWaits;          // waits that returned without an event
+    UInt64 fTotalWaitUSec;          // time blocked in the backend
+    UInt64 fNumEvents;              // events returned by the backend
+    UInt64 fTotalDispatchUSec;      // sum of readiness -> Signal latency
+    UInt64 fMaxDispatchUSec;
+    UInt64 fLagUSec;                // smoothed dispatch latency, see GetLagUSec
+    UInt64 fNumResolveMisses;       // events whose ID was no longer registered
+    UInt64 fNumWatches;             // select_watchevent calls
+    UInt64 fNumModWatches;          // select_modwatch calls
+    UInt64 fNumRemoves;             // select_removeevent calls
+
+    UInt64 fWaitHistogram[kNumHistogramBuckets];
+    UInt64 fBatchHistogram[kNumHistogramBuckets];     // events per wakeup
+    UInt64 fDispatchHistogram[kNumHistogramBuckets];
+
+    // per second rate of a counter between an older snapshot and this one
+    Float64 Rate(UInt64 Snapshot::*inCounter, const Snapshot &inPrevious) const {
+      SInt64 theElapsed = fSampleTimeMilli - inPrevious.fSampleTimeMilli;
+      if (theElapsed <= 0) return 0;
+      return (Float64) (this->*inCounter - inPrevious.*inCounter) * 1000 / theElapsed;
+    }
+  };
+
+  EventMetrics();
+
+  //
+  // Called by the EventThread only.
+  void RecordWait(SInt64 inWaitUSec, UInt32 inNumEvents);
+  void RecordDispatch(SInt64 inDispatchUSec);
+  void RecordResolveMiss() { Increment(fNumResolveMisses); }
+
+  //
+  // Called from any thread that arms an EventContext.
+  void RecordWatch() { fNumWatches.fetch_add(1, std::memory_order_relaxed); }
+  void RecordModWatch() { fNumModWatches.fetch_add(1, std::memory_order_relaxed); }
+  void RecordRemove() { fNumRemoves.fetch_add(1, std::memory_order_relaxed); }
+
+  void GetSnapshot(Snapshot *outSnapshot);
+
+  //
+  // Event loop lag: moving average (1/8 weight) of the dispatch latency.
+  // Cheap enough to poll on every accept for admission control.
+  UInt64 GetLagUSec() { return fLagUSec.load(std::memory_order_relaxed); }
+
+ private:
+
+  typedef std::atomic<UInt64> Counter;
+
+  // single writer, a relaxed load/store pair is enough and avoids the lock prefix
+  static void Increment(Counter &ioCounter, UInt64 inValue = 1) {
+    ioCounter.store(ioCounter.load(std::memory_order_relaxed) + inValue,
+                    std::memory_order_relaxed);
+  }
+
+  static UInt32 GetBucket(UInt64 inValue);
+
+  Counter fNumWaits;
+  Counter fNumEmptyWaits;
+  Counter fTotalWaitUSec;
+  Counter fNumEvents;
+  Counter fTotalDispatchUSec;
+  Counter fMaxDispatchUSec;
+  Counter fLagUSec;
+  Counter fNumResolveMisses;
+  Counter fNumWatches;
+  Counter fNumModWatches;
+  Counter fNumRemoves;
+
+  Counter fWaitHistogram[kNumHistogramBuckets];
+  Counter fBatchHistogram[kNumHistogramBuckets];
+  Counter fDispatchHistogram[kNumHistogramBuckets];
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __CF_NET_EVENT_METRICS_H__
@@ -0,0 +1,65 @@
+/**
+ * @file EventPoller.h
+ *
+ * thread-per-core 模式下 TaskThread 私有的 I/O 轮询器。
+ *
+ * 每个 short task thread 拥有一个 EventPoller(独立的 epoll 实例)，注册到
+ * 该轮询器的 EventContext 的事件在该线程内分发并执行，不经过 EventThread，
+ * 也没有线程切换。Listener 仍由 EventThread 处理，accept 时把连接分配给
+ * 某个线程，此后连接的所有 I/O 都在该线程完成。
+ */
+
+#ifndef __CF_NET_EVENT_POLLER_H__
+#define __CF_NET_EVENT_POLLER_H__
+
+#include <CF/Net/Socket/EventContext.h>
+
+namespace CF {
+namespace Net {
+
+class EventPoller : public Thread::TaskThreadPoller {
+ public:
+
+  /**
+   * @brief 创建轮询器，当前平台不支持时返回 nullptr
+   *
+   * 可作为 TaskThreadPool::CreateThreads 的 PollerFactory
+   */
+  static Thread::TaskThreadPoller *Create();
+
+  /**
+   * @brief 以轮转方式选择一个带轮询器的 TaskThread
+   *
+   * @return nullptr 表示未启用 thread-per-core 模式
+   */
+  static Thread::TaskThread *PickThread();
+
+  ~EventPoller() override;
+
+  void Poll(SInt64 inTimeoutMilli) override;
+  void Wakeup() override;
+
+  //
+  // Used by EventContext in place of select_watchevent/modwatch/removeevent
+  int WatchEvent(EventContext *inContext, int which);
+  int ModWatch(EventContext *inContext, int which);
+  int RemoveEvent(SOCKET inFileDesc);
+
+ private:
+
+  enum {
+    kMaxEventsPerPoll = 256   //UInt32
+  };
+
+  EventPoller(int inEpollFD, int inWakeupFD);
+
+  int fEpollFD;
+  int fWakeupFD;  // eventfd, 其他线程投递任务时写入以唤醒 Poll
+
+  static std::atomic_uint sThreadPicker;
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __CF_NET_EVENT_POLLER_H__
@@ -85,6 +85,10 @@ class Socket : public EventContext {
 
   static void Release() {
     if (sEventThread != nullptr) {
+      sEventThread->SendStopRequest();
+#if !MACOSXEVENTQUEUE
+      ::select_wakeup(); // don't wait for the select timeout
+#endif
       sEventThread->StopAndWaitForThread();
       delete sEventThread;
       sEventThread = nullptr;
@@ -97,6 +101,13 @@ class Socket : public EventContext {
 
   static EventThread *GetEventThread() { return sEventThread; }
 
+  /**
+   * SO_BUSY_POLL value applied to every Socket opened or accepted after
+   * this call, 0 disables it. Only supported on Linux.
+   */
+  static void SetDefaultBusyPoll(UInt32 inBusyPollUSec) { sBusyPollUSec = inBusyPollUSec; }
+  static UInt32 GetDefaultBusyPoll() { return sBusyPollUSec; }
+
   /**
    * Bind - binds the socket to the following address.
    * @return CF_FileNotOpen, CF_NoErr, or POSIX error code.
@@ -114,6 +125,8 @@ class Socket : public EventContext {
 
   void KeepAlive();
 
+  void BusyPoll(UInt32 inBusyPollUSec);
+
   void SetSocketBufSize(UInt32 inNewSize);
 
   /**
@@ -133,12 +146,84 @@ class Socket : public EventContext {
    */
   OS_Error Read(void *buffer, UInt32 length, UInt32 *rcvLen);
 
+  /**
+   * ReadV - same as Read, but scatters the data into an iovec
+   * @return CF_FileNotOpen, CF_NoErr, or POSIX error code.
+   */
+  OS_Error ReadV(const struct iovec *iov, UInt32 numVecs, UInt32 *rcvLen);
+
   /**
    * WriteV - same as Send, but takes an iovec
    * @return CF_FileNotOpen, CF_NoErr, or POSIX error code.
    */
   OS_Error WriteV(const struct iovec *iov, UInt32 numVecs, UInt32 *outLengthSent);
 
+  /**
+   * SendFile - sends inLength bytes of a file starting at *ioOffset without
+   * copying them through user space (sendfile, or splice when the file does
+   * not support it).
+   *
+   * Like Send, this may send less than asked for. *ioOffset is advanced by
+   * the bytes sent; on EAGAIN request EV_WR and call again with the updated
+   * offset. Bytes already spliced into the pipe are kept for the next call,
+   * so don't switch to another file before the range is fully sent.
+   * 0 bytes sent with no error means the file ended.
+   *
+   * @return CF_FileNotOpen, CF_NoErr, or POSIX error code.
+   */
+  OS_Error SendFile(int inFileDesc, UInt64 *ioOffset, UInt32 inLength,
+                    UInt32 *outLengthSent);
+
+  /**
+   * SetZeroCopyThreshold - Send and WriteV calls of at least inThreshold
+   * bytes use MSG_ZEROCOPY, smaller ones keep the copy path. 0 turns it off.
+   * Only supported on Linux.
+   *
+   * A zero-copy send returns before the kernel is done with the data, so the
+   * buffer must stay untouched until the send completes: take
+   * GetZeroCopySeq() after the send and check IsZeroCopyDone. Completions
+   * come from the error queue and wake the task with a kWriteEvent. If the
+   * kernel had to copy anyway (e.g. loopback), the mode is turned off.
+   *
+   * @return CF_NoErr, or POSIX error code if not supported.
+   */
+  OS_Error SetZeroCopyThreshold(UInt32 inThreshold);
+
+  // Number of zero-copy sends issued so far
+  UInt32 GetZeroCopySeq();
+
+  // true once the first inSeq zero-copy sends have completed
+  bool IsZeroCopyDone(UInt32 inSeq);
+
+  bool IsZeroCopyPending() { return !IsZeroCopyDone(GetZeroCopySeq()); }
+
+  /**
+   * ReapZeroCopy - reads completion notifications from the error queue.
+   * Called on EV_ER by the event thread, may also be polled.
+   * @return the number of notifications read
+   */
+  UInt32 ReapZeroCopy();
+
+  /**
+   * SetAdaptiveSndBuf - sizes SO_SNDBUF from TCP_INFO samples instead of a
+   * fixed value. Only supported on Linux.
+   *
+   * Every few hundred msec of sending, the send rate times the RTT gives the
+   * bandwidth-delay product. A socket that hits EAGAIN is sized to twice the
+   * larger of that and the congestion window; one that sends less than it
+   * could shrinks to twice what it uses; an idle one drops to inMinSize.
+   * The sum over all adaptive sockets is kept within SetSndBufBudget.
+   */
+  void SetAdaptiveSndBuf(UInt32 inMinSize, UInt32 inMaxSize);
+
+  // Drops an adaptive SO_SNDBUF to its minimum if the budget is exceeded.
+  // Sessions call this when they go idle, e.g. between keep-alive requests.
+  void TrimSndBuf();
+
+  // Total SO_SNDBUF of the adaptive sockets, 0 is unlimited
+  static void SetSndBufBudget(UInt64 inBytes) { sSndBufBudget = inBytes; }
+  static UInt64 GetSndBufInUse() { return sSndBufInUse; }
+
   // You can query for the Socket's state
 
   bool IsConnected() { return (bool) (fState & kConnected); }
@@ -171,13 +256,15 @@ class Socket : public EventContext {
 
   Socket(Thread::Task *inNotifyTask, UInt32 inSocketType);
 
-  ~Socket() override = default;
+  ~Socket() override;
 
   /**
    * @return returns QTSS_NoErr, or appropriate posix error
    */
   OS_Error Open(int theType);
 
+  bool ReapErrorQueue() override;
+
   UInt32 fState;
 
   enum {
@@ -197,6 +284,30 @@ class Socket : public EventContext {
 
   StrPtrLen *fLocalAddrStrPtr;
   StrPtrLen *fLocalDNSStrPtr;
+
+#if __Linux__
+  long spliceFile(int inFileDesc, UInt64 inOffset, UInt32 inLength);
+
+  int fSplicePipe[2];     // created on the first splice
+  UInt32 fSplicePending;  // file bytes in fSplicePipe, not yet sent
+
+  std::atomic<UInt32> fZeroCopyThreshold;  // 0: disabled
+  bool fZeroCopyEnabled;                   // SO_ZEROCOPY set
+  UInt32 fZeroCopySeq;                     // zero-copy sends issued
+  std::atomic<UInt32> fZeroCopyDone;       // zero-copy sends completed
+
+  // accounts sends for SetAdaptiveSndBuf, resizes once per sample period
+  void adaptSndBuf(UInt32 inLengthSent, bool inBlocked);
+  void setSndBuf(UInt32 inSize);
+
+  UInt32 fSndBufSize;         // 0: not adaptive
+  UInt32 fSndBufMin;
+  UInt32 fSndBufMax;
+  SInt64 fSndBufSampleTime;
+  UInt64 fSndBufSampleBytes;  // sent since fSndBufSampleTime
+  bool fSndBufBlocked;        // EAGAIN since fSndBufSampleTime
+#endif
+
   char fPortBuffer[kPortBufSizeInBytes];
   StrPtrLen fPortStr;
 
@@ -208,6 +319,9 @@ class Socket : public EventContext {
   };
 
   static EventThread *sEventThread;
+  static UInt32 sBusyPollUSec;
+  static UInt64 sSndBufBudget;
+  static std::atomic<UInt64> sSndBufInUse;
 
 };
 
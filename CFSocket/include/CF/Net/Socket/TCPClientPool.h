@@ -0,0 +1,154 @@
+/**
+ * @file TCPClientPool.h
+ *
+ * 按目的地址复用 TCPClientSocket 连接。
+ *
+ * 归还的连接进入该目的地的空闲队列，下次 Acquire 先用 MSG_PEEK 检查连接
+ * 是否仍然可用(对端未关闭、没有残留数据)，可用则直接交出，省去 connect
+ * 的握手。每个目的地的连接数有上限，达到上限时请求的 Task 排队，有连接
+ * 归还或关闭时按先来先得的顺序预留给队首的 Task，并通过 Signal 通知它再
+ * 次调用 Acquire。空闲超时由池自身作为 Task 的定时器驱动。
+ */
+
+#ifndef __CF_NET_TCP_CLIENT_POOL_H__
+#define __CF_NET_TCP_CLIENT_POOL_H__
+
+#include <string.h>
+#include <CF/HashTable.h>
+#include <CF/Queue.h>
+#include <CF/Core/Mutex.h>
+#include <CF/Net/Socket/ClientSocket.h>
+
+namespace CF {
+namespace Net {
+
+class TCPClientPool : public Thread::Task {
+ public:
+
+  enum {
+    kDefaultMaxPerHost = 8,               //UInt32
+    kDefaultIdleTimeoutInMsec = 30000     //UInt32
+  };
+
+  /**
+   * The pool is a Task: delete it by sending it a kKillEvent. Connections
+   * that are handed out at that time belong to their users.
+   */
+  explicit TCPClientPool(UInt32 inMaxPerHost = kDefaultMaxPerHost,
+                         UInt32 inIdleTimeoutInMsec = kDefaultIdleTimeoutInMsec);
+
+  ~TCPClientPool() override;
+
+  /**
+   * @brief 取得一个到 inAddr:inPort 的连接
+   *
+   * 优先复用空闲连接；否则在未达上限时创建新连接，新连接在第一次
+   * Send/Read 时才 connect。socket 事件会通知 inTask。
+   *
+   * @param inTask  达到上限时排队，连接可用时收到 kUpdateEvent，
+   *                再次调用 Acquire 即可取得预留给它的连接
+   * @return nullptr if the host is at its limit
+   */
+  TCPClientSocket *Acquire(UInt32 inAddr, UInt16 inPort, Thread::Task *inTask);
+
+  /**
+   * @brief 归还连接
+   *
+   * @param inReusable  false if the connection is in an unknown state (an
+   *                    error, a response not fully read, no keep-alive), it
+   *                    is closed then
+   */
+  void Release(TCPClientSocket *inSocket, bool inReusable = true);
+
+  // Leaves the waiting list, e.g. when inTask gives up. A task that waits
+  // must call this before it is deleted.
+  void CancelWait(Thread::Task *inTask);
+
+  UInt32 GetMaxPerHost() { return fMaxPerHost; }
+
+ private:
+
+  class Host;
+
+  class PooledSocket : public TCPClientSocket {
+   public:
+    PooledSocket(Host *inHost);
+
+    Host *fHost;
+    SInt64 fIdleSince;
+    QueueElem fElem;
+  };
+
+  // A task waiting for a connection, or holding a reservation
+  struct Waiter {
+    Thread::Task *fTask;
+    PooledSocket *fSocket;  // reserved connection, nullptr: open a new one
+    SInt64 fGrantTime;
+    QueueElem fElem;
+  };
+
+  class HostKey;
+
+  class Host {
+   public:
+    Host(UInt32 inAddr, UInt16 inPort);
+
+    UInt32 fAddr;
+    UInt16 fPort;
+    UInt32 fNumOpen;    // handed out, idle, and reserved slots
+    Queue fIdle;        // the tail is the most recently used
+    Queue fWaiters;
+    Queue fGranted;     // waiters served, not back yet
+
+    UInt32 fHashValue;
+    Host *fNextHashEntry;
+  };
+
+  class HostKey {
+   public:
+    HostKey(UInt32 inAddr, UInt16 inPort)
+        : fAddr(inAddr), fPort(inPort), fHashValue(hash(inAddr, inPort)) {}
+    explicit HostKey(Host *inHost)
+        : fAddr(inHost->fAddr), fPort(inHost->fPort), fHashValue(inHost->fHashValue) {}
+
+    UInt32 GetHashKey() { return fHashValue; }
+
+    static UInt32 hash(UInt32 inAddr, UInt16 inPort) {
+      return (inAddr * 2654435761U) ^ (inPort * 40503U);
+    }
+
+    friend int operator==(const HostKey &key1, const HostKey &key2) {
+      return key1.fAddr == key2.fAddr && key1.fPort == key2.fPort;
+    }
+
+   private:
+    UInt32 fAddr;
+    UInt16 fPort;
+    UInt32 fHashValue;
+  };
+
+  typedef HashTable<Host, HostKey> HostTable;
+
+  SInt64 Run() override;
+
+  // These need fMutex
+  bool isHealthy(PooledSocket *inSocket);
+  void closeSocket(PooledSocket *inSocket);
+  void grant(Host *ioHost, PooledSocket *inSocket);
+  TCPClientSocket *handOut(PooledSocket *inSocket, Thread::Task *inTask);
+  void reapHost(Host *ioHost, SInt64 inNow);
+
+  enum {
+    kHostTableSize = 251   //UInt32
+  };
+
+  Core::Mutex fMutex;
+  HostTable fHosts;
+  UInt32 fMaxPerHost;
+  UInt32 fIdleTimeoutInMsec;
+};
+
+} // namespace Net
+} // namespace CF
+
+#endif // __CF_NET_TCP_CLIENT_POOL_H__
@@ -51,10 +51,17 @@ class TCPListenerSocket : public TCPSocket, public Thread::IdleTask {
         fAddr(0),
         fPort(0),
         fOutOfDescriptors(false),
-        fSleepBetweenAccepts(false) {
+        fSleepBetweenAccepts(false),
+        fAcceptsPaused(false),
+        fReservedFileDesc(-1),
+        fFastOpenQueueLength(sFastOpenQueueLength),
+        fDeferAcceptSec(sDeferAcceptSec),
+        fRcvBufSize(sRcvBufSize),
+        fSessionSndBufSize(sSessionSndBufSize),
+        fBufferPolicy(sBufferPolicy) {
     this->SetTaskName("TCPListenerSocket");
   }
-  ~TCPListenerSocket() override = default;
+  ~TCPListenerSocket() override;
 
   //
   // Send a TCPListenerObject a Kill event to delete it.
@@ -67,6 +74,44 @@ class TCPListenerSocket : public TCPSocket, public Thread::IdleTask {
    */
   OS_Error Initialize(UInt32 addr, UInt16 port);
 
+  //
+  // Options, set them before Initialize. They start from the defaults below.
+
+  // TCP_FASTOPEN: SYNs carrying data are served without waiting for the
+  // handshake, at most inQueueLength of them pending. 0 turns it off
+  void SetFastOpen(UInt32 inQueueLength) { fFastOpenQueueLength = inQueueLength; }
+
+  // TCP_DEFER_ACCEPT: a connection is reported only once the client has sent
+  // data, or after inSeconds. 0 turns it off
+  void SetDeferAccept(UInt32 inSeconds) { fDeferAcceptSec = inSeconds; }
+
+  // SO_RCVBUF of the listen Socket (inherited by accepted sockets) and
+  // SO_SNDBUF of accepted sockets, 0 leaves the system default
+  void SetBufSizes(UInt32 inRcvBufSize, UInt32 inSessionSndBufSize) {
+    fRcvBufSize = inRcvBufSize;
+    fSessionSndBufSize = inSessionSndBufSize;
+  }
+
+  enum BufferPolicy {
+    // SetBufSizes applies, the kernel's autotuning is off for these sockets
+    kFixedBuffers = 0,
+    // no SO_RCVBUF/SO_SNDBUF at all, the kernel sizes them per connection
+    kAutoTuneBuffers = 1,
+    // SO_RCVBUF is autotuned, SO_SNDBUF follows Socket::SetAdaptiveSndBuf
+    // between kMinAdaptiveSndBuf and kMaxAdaptiveSndBuf
+    kAdaptiveBuffers = 2
+  };
+
+  void SetBufferPolicy(BufferPolicy inPolicy) { fBufferPolicy = inPolicy; }
+
+  static void SetDefaultFastOpen(UInt32 inQueueLength) { sFastOpenQueueLength = inQueueLength; }
+  static void SetDefaultDeferAccept(UInt32 inSeconds) { sDeferAcceptSec = inSeconds; }
+  static void SetDefaultBufSizes(UInt32 inRcvBufSize, UInt32 inSessionSndBufSize) {
+    sRcvBufSize = inRcvBufSize;
+    sSessionSndBufSize = inSessionSndBufSize;
+  }
+  static void SetDefaultBufferPolicy(BufferPolicy inPolicy) { sBufferPolicy = inPolicy; }
+
   //You can query the listener to see if it is failing to accept
   //connections because the OS is out of descriptors.
   bool IsOutOfDescriptors() { return fOutOfDescriptors; }
@@ -75,25 +120,54 @@ class TCPListenerSocket : public TCPSocket, public Thread::IdleTask {
   void RunNormal() { fSleepBetweenAccepts = false; }
 
   //derived object must implement a way of getting tasks & sockets to this object
+  //return nullptr to refuse the connection, it is then passed to RejectConnection
   virtual Thread::Task *GetSessionTask(TCPSocket **outSocket) = 0;
 
+  //called with an accepted Socket that has no session, the default just closes it.
+  //must not block, we are on the EventThread
+  virtual void RejectConnection(int osSocket);
+
   SInt64 Run() override;
 
  private:
 
   enum {
-    kTimeBetweenAcceptsInMsec = 1000,   //UInt32
-    kListenQueueLength = 128            //UInt32
+    kTimeBetweenAcceptsInMsec = 100,    //UInt32
+    kListenQueueLength = 128,           //UInt32
+    kMinAdaptiveSndBuf = 16 * 1024,     //UInt32
+    kMaxAdaptiveSndBuf = 4 * 1024 * 1024 //UInt32
   };
 
   void ProcessEvent(int eventBits) override;
   OS_Error listen(UInt32 queueLength);
 
+  // stop watching the listen Socket, Run will retry after kTimeBetweenAcceptsInMsec
+  void PauseAccepts();
+
+  // out of descriptors: free the reserved fd to accept and reject one pending
+  // connection, so the client gets an answer instead of waiting in the backlog
+  void RejectWithReservedFileDesc();
+
   UInt32 fAddr;
   UInt16 fPort;
 
   bool fOutOfDescriptors;
   bool fSleepBetweenAccepts;
+  bool fAcceptsPaused;   // listen Socket is not watched, the idle timer is set
+
+  int fReservedFileDesc; // kept open for RejectWithReservedFileDesc
+
+  UInt32 fFastOpenQueueLength;
+  UInt32 fDeferAcceptSec;
+  UInt32 fRcvBufSize;
+  UInt32 fSessionSndBufSize;
+  BufferPolicy fBufferPolicy;
+
+  static BufferPolicy sBufferPolicy;
+  static UInt32 sFastOpenQueueLength;
+  static UInt32 sDeferAcceptSec;
+  static UInt32 sRcvBufSize;
+  static UInt32 sSessionSndBufSize;
 };
 
 } // namespace Net
@@ -78,6 +78,28 @@ class TCPSocket : public Socket {
   OS_Error Connect(UInt32 inRemoteAddr, UInt16 inRemotePort);
   //OS_Error  CheckAsyncConnect();
 
+  /**
+   * @brief 开启 TCP_FASTOPEN_CONNECT (Linux 4.11+)
+   *
+   * 必须在 Connect 之前调用。此后 Connect 立即返回，握手推迟到第一次
+   * Send，数据随 SYN 发出(有 cookie 时省去一个 RTT)。
+   *
+   * @return EOPNOTSUPP or ENOPROTOOPT if the system can't, use
+   *         ConnectAndSend then
+   */
+  OS_Error SetFastOpenConnect();
+
+  /**
+   * @brief 以 sendto(MSG_FASTOPEN) 同时发起连接并发送数据
+   *
+   * 没有 cookie 时内核只发出 SYN，返回 EINPROGRESS，数据需要在连接建立
+   * 后(EV_WR)用 Send 重发。
+   *
+   * @param outLengthSent  bytes carried by the SYN
+   */
+  OS_Error ConnectAndSend(UInt32 inRemoteAddr, UInt16 inRemotePort,
+                          void *inBuffer, UInt32 inLength, UInt32 *outLengthSent);
+
   // Basically a copy constructor for this object, also NULLs out the data
   // in tcpSocket.
   void SnarfSocket(TCPSocket &tcpSocket);
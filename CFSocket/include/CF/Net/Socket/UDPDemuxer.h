@@ -35,110 +35,45 @@
 #ifndef __UDPDEMUXER_H__
 #define __UDPDEMUXER_H__
 
+#include <atomic>
 #include <CF/StrPtrLen.h>
-#include <CF/HashTable.h>
 #include <CF/Core/Mutex.h>
 
 namespace CF {
 namespace Net {
 
-class Task;
-class UDPDemuxerKey;
-
-//IMPLEMENTATION ONLY:
-//HASH TABLE CLASSES USED ONLY IN IMPLEMENTATION
-
-class UDPDemuxerUtils {
- private:
-
-  static UInt32 ComputeHashValue(UInt32 inRemoteAddr, UInt16 inRemotePort) {
-    return ((inRemoteAddr << 16) + inRemotePort);
-  }
-
-  friend class UDPDemuxerTask;
-  friend class UDPDemuxerKey;
-};
-
 class UDPDemuxerTask {
  public:
 
-  UDPDemuxerTask()
-      : fRemoteAddr(0), fRemotePort(0),
-        fHashValue(0), fNextHashEntry(nullptr) {}
+  UDPDemuxerTask() : fRemoteAddr(0), fRemotePort(0) {}
   virtual ~UDPDemuxerTask() = default;
 
   UInt32 GetRemoteAddr() { return fRemoteAddr; }
 
- private:
-
-  void set(UInt32 inRemoteAddr, UInt16 inRemotePort) {
-    fRemoteAddr = inRemoteAddr;
-    fRemotePort = inRemotePort;
-    fHashValue = UDPDemuxerUtils::ComputeHashValue(fRemoteAddr, fRemotePort);
-  }
-
-  //key values
-  UInt32 fRemoteAddr;
-  UInt16 fRemotePort;
-
-  //precomputed for performance
-  UInt32 fHashValue;
-
-  UDPDemuxerTask *fNextHashEntry;
-
-  friend class UDPDemuxerKey;
-  friend class UDPDemuxer;
-  friend class HashTable<UDPDemuxerTask, UDPDemuxerKey>;
-};
+  UInt16 GetRemotePort() { return fRemotePort; }
 
-class UDPDemuxerKey {
  private:
 
-  //CONSTRUCTOR / DESTRUCTOR:
-  UDPDemuxerKey(UInt32 inRemoteAddr, UInt16 inRemotePort)
-      : fRemoteAddr(inRemoteAddr), fRemotePort(inRemotePort) {
-    fHashValue = UDPDemuxerUtils::ComputeHashValue(inRemoteAddr, inRemotePort);
-  }
-
-  ~UDPDemuxerKey() {}
-
- private:
-
-  //PRIVATE ACCESSORS:
-  UInt32 GetHashKey() { return fHashValue; }
-
-  //these functions are only used by the hash table itself. This constructor
-  //will break the "Set" functions.
-  UDPDemuxerKey(UDPDemuxerTask *elem) : fRemoteAddr(elem->fRemoteAddr),
-                                        fRemotePort(elem->fRemotePort),
-                                        fHashValue(elem->fHashValue) {}
-
-  friend int operator==(const UDPDemuxerKey &key1, const UDPDemuxerKey &key2) {
-    if ((key1.fRemoteAddr == key2.fRemoteAddr) &&
-        (key1.fRemotePort == key2.fRemotePort))
-      return true;
-    return false;
-  }
-
-  //data:
+  //key values
   UInt32 fRemoteAddr;
   UInt16 fRemotePort;
-  UInt32 fHashValue;
 
-  friend class HashTable<UDPDemuxerTask, UDPDemuxerKey>;
   friend class UDPDemuxer;
 };
 
-//CLASSES USED ONLY IN IMPLEMENTATION
-typedef HashTable<UDPDemuxerTask, UDPDemuxerKey> UDPDemuxerHashTable;
-
+/**
+ * @brief 按源地址和端口查找 UDPDemuxerTask
+ *
+ * 表按 64 位哈希分成 kNumShards 个分片，每个分片是独立的开放寻址表，
+ * 装载超过一半时扩容。修改在分片的 mutex 下进行，查找不加锁，用分片的
+ * 序列号(seqlock)检测并发修改后重试，收包线程之间互不阻塞。扩容后旧表
+ * 不立即释放(查找可能还在读)，析构时统一回收，总开销不超过当前表的大小。
+ */
 class UDPDemuxer {
  public:
 
-  UDPDemuxer() : fHashTable(kMaxHashTableSize), fMutex() {}
-  ~UDPDemuxer() = default;
-
-  //These functions grab the Mutex and are therefore premptive safe
+  UDPDemuxer();
+  ~UDPDemuxer();
 
   // Return values: OS_NoErr, or EPERM if there is already a task registered
   // with this address combination
@@ -148,23 +83,60 @@ class UDPDemuxer {
   // is not registered
   OS_Error UnregisterTask(UInt32 inRemoteAddr, UInt16 inRemotePort, UDPDemuxerTask *inTaskP);
 
-  //Assumes that parent has grabbed the Mutex!
+  // Takes no lock and may run concurrently with Register / Unregister. As
+  // before, the caller makes sure the returned task is not deleted while
+  // it is in use.
   UDPDemuxerTask *GetTask(UInt32 inRemoteAddr, UInt16 inRemotePort);
 
   bool AddrInMap(UInt32 inRemoteAddr, UInt16 inRemotePort) {
     return (this->GetTask(inRemoteAddr, inRemotePort) != nullptr);
   }
 
-  Core::Mutex *GetMutex() { return &fMutex; }
-  UDPDemuxerHashTable *GetHashTable() { return &fHashTable; }
+  UInt32 GetNumTasks();
 
  private:
 
   enum {
-    kMaxHashTableSize = 2747//is this prime? it should be... //UInt32
+    kNumShards = 16,          //UInt32, power of 2
+    kShardBits = 4,           //UInt32, log2(kNumShards)
+    kInitialTableSize = 64    //UInt32, power of 2
+  };
+
+  struct Entry {
+    std::atomic<UInt64> fKey;   // 0: empty
+    std::atomic<UDPDemuxerTask *> fTask;
   };
-  UDPDemuxerHashTable fHashTable;
-  Core::Mutex fMutex;//this data structure is shared!
+
+  struct Table {
+    UInt32 fMask;
+    Entry *fEntries;
+    Table *fRetired;  // replaced tables, freed by the destructor
+  };
+
+  struct Shard {
+    Core::Mutex fMutex;         // serializes writers
+    std::atomic<UInt32> fSeq;   // odd while a writer modifies the table
+    std::atomic<Table *> fTable;
+    UInt32 fNumTasks;
+  };
+
+  static UInt64 makeKey(UInt32 inRemoteAddr, UInt16 inRemotePort) {
+    // the top bit marks the slot used, so that 0.0.0.0:0 is a valid key
+    return (((UInt64) inRemoteAddr << 16) | inRemotePort) | (1ULL << 63);
+  }
+
+  static UInt64 hashKey(UInt64 inKey);
+
+  static Table *newTable(UInt32 inSize);
+
+  Shard &shardFor(UInt64 inHash) { return fShards[inHash >> (64 - kShardBits)]; }
+
+  // These need the shard's mutex
+  SInt32 findSlot(Table *inTable, UInt64 inKey, UInt64 inHash);
+  void insertSlot(Table *inTable, UInt64 inKey, UInt64 inHash, UDPDemuxerTask *inTaskP);
+  void grow(Shard &ioShard);
+
+  Shard fShards[kNumShards];
 };
 
 } // namespace Net
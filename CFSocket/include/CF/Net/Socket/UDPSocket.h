@@ -61,12 +61,35 @@ class UDPSocket : public Socket {
     kWantsDemuxer = 0x0100U //UInt32
   };
 
+  enum {
+    kMaxBatchSize = 64,         // datagrams per recvmmsg/sendmmsg call
+    kMaxOffloadSegments = 64,   // kernel limit of UDP_SEGMENT
+    kMaxOffloadLength = 65507   // UDP_SEGMENT sends one IP datagram to the stack
+  };
+
+  /**
+   * @brief 批量收发中的一个数据报
+   *
+   * 发送时 fLength 为数据长度，fSegmentSize 非 0 表示按该大小切分为多个
+   * 数据报(UDP_SEGMENT，内核不支持时在用户态切分)。
+   * 接收时 fBufferSize 为缓冲区大小，返回后 fLength 为接收长度，开启 GRO 时
+   * fSegmentSize 为合并前每个数据报的大小(0 表示未合并)。
+   */
+  struct Datagram {
+    UInt32 fRemoteAddr;   // host byte order
+    UInt16 fRemotePort;
+    UInt16 fSegmentSize;
+    void *fBuffer;
+    UInt32 fBufferSize;
+    UInt32 fLength;
+  };
+
   UDPSocket(Thread::Task *inTask, UInt32 inSocketType);
 
   ~UDPSocket() override { delete fDemuxer; }
 
-  //Open
-  OS_Error Open() { return Socket::Open(SOCK_DGRAM); }
+  //Open, also checks whether the kernel takes UDP_SEGMENT on this Socket
+  OS_Error Open();
 
   OS_Error JoinMulticast(UInt32 inRemoteAddr);
 
@@ -83,6 +106,32 @@ class UDPSocket : public Socket {
   OS_Error RecvFrom(UInt32 *outRemoteAddr, UInt16 *outRemotePort,
                     void *ioBuffer, UInt32 inBufLen, UInt32 *outRecvLen);
 
+  /**
+   * @brief 一次系统调用发送多个数据报(sendmmsg)
+   *
+   * 用户态切分的数据报可能只发出了前面几段，这时它的 fBuffer、fLength 被
+   * 推进到未发送的部分，从 inDatagrams[*outNumSent] 重试不会重复发送。
+   *
+   * @param outNumSent - 完整发送的数据报个数，可能小于 inNumDatagrams
+   * @return 一个也没有发送时返回错误码
+   */
+  OS_Error SendToBatch(Datagram *inDatagrams, UInt32 inNumDatagrams,
+                       UInt32 *outNumSent);
+
+  /**
+   * @brief 一次系统调用接收多个数据报(recvmmsg)
+   *
+   * 至少收到一个数据报或出错时返回，不会等待填满。
+   *
+   * @param outNumRecv - 收到的数据报个数
+   */
+  OS_Error RecvFromBatch(Datagram *ioDatagrams, UInt32 inNumDatagrams,
+                         UInt32 *outNumRecv);
+
+  // UDP_GRO: let the kernel coalesce received datagrams of a flow, buffers
+  // passed to RecvFromBatch should then be 64KB
+  OS_Error SetReceiveOffload(bool inEnable);
+
   //A UDP Socket may or may not have a demuxer associated with it. The demuxer
   //is a data structure so the Socket can associate incoming data with the proper
   //task to process that data (based on source IP addr & port)
@@ -90,8 +139,15 @@ class UDPSocket : public Socket {
 
  private:
 
+  OS_Error sendToBatchSlow(Datagram *inDatagrams, UInt32 inNumDatagrams,
+                           UInt32 *outNumSent);
+  // the first inSent bytes of a split datagram are out
+  static void advanceDatagram(Datagram *ioDatagram, UInt32 inSent);
+
   UDPDemuxer *fDemuxer;
   struct sockaddr_in fMsgAddr;
+
+  bool fSegmentOffload;     // UDP_SEGMENT works on this Socket
 };
 
 } // namespace Net
@@ -42,15 +42,19 @@ namespace Net {
 
 class UDPSocketPair;
 
+/**
+ * @brief UDP Socket pair 池
+ *
+ * 按本地地址分片加锁，每个地址维护：已建 pair 的队列(复用时从队头轮转
+ * 检查)、端口槽到 pair 的索引，以及空闲端口槽位图。分配新端口时从位图
+ * 取第一个空闲槽，而不是从 kLowestUDPPort 起逐个尝试 bind。被其他进程
+ * 占用的端口在位图中标记，位图用尽时清除这些标记重新尝试。
+ */
 class UDPSocketPool {
  public:
 
-  UDPSocketPool() : fMutex() {}
-  virtual ~UDPSocketPool() = default;
-
-  //Skanky access to member data
-  Core::Mutex *GetMutex() { return &fMutex; }
-  Queue *GetSocketQueue() { return &fUDPQueue; }
+  UDPSocketPool();
+  virtual ~UDPSocketPool();
 
   //Gets a UDP Socket out of the pool.
   //inIPAddr = IP address you'd like this pair to be bound to.
@@ -82,18 +86,58 @@ class UDPSocketPool {
 
   enum {
     kLowestUDPPort = 6970,  //UInt16
-    kHighestUDPPort = 65535 //UInt16
+    kHighestUDPPort = 65535, //UInt16
+
+    // socket A binds the even port of a slot, B the next one
+    kNumPortSlots = (kHighestUDPPort - kLowestUDPPort) / 2,  //UInt32
+    kNumBitmapWords = (kNumPortSlots + 63) / 64,             //UInt32
+
+    kNumShards = 8,       //UInt32, power of 2
+    kMaxReuseProbes = 4   //UInt32, pairs checked for reuse before creating one
+  };
+
+  // The pairs bound to one local address
+  struct AddrPool {
+    UInt32 fAddr;
+    AddrPool *fNext;
+    Queue fPairs;
+    UDPSocketPair **fBySlot;            // kNumPortSlots entries
+    UInt64 fInUse[kNumBitmapWords];     // slots held by our pairs
+    UInt64 fForeign[kNumBitmapWords];   // bind failed, held by someone else
+    UInt32 fHint;                       // word to start the next search at
   };
 
-  Queue fUDPQueue;
-  Core::Mutex fMutex;
+  struct Shard {
+    Core::Mutex fMutex;
+    AddrPool *fPools;
+  };
+
+  static SInt32 portToSlot(UInt16 inPort);
+
+  static UInt16 slotToPort(UInt32 inSlot) {
+    return static_cast<UInt16>(kLowestUDPPort + inSlot * 2);
+  }
+
+  Shard &shardFor(UInt32 inAddr);
+
+  // These need the shard's mutex
+  AddrPool *getAddrPool(Shard &ioShard, UInt32 inAddr);
+  SInt32 allocSlot(AddrPool *ioPool);
+  OS_Error bindPair(UInt32 inAddr, UInt16 inPort, UDPSocketPair **outPair);
+  void addPair(AddrPool *ioPool, UDPSocketPair *inPair, SInt32 inSlot);
+  UDPSocketPair *createPair(AddrPool *ioPool, UInt32 inAddr, UInt16 inPort);
+
+  static bool isReusable(UDPSocketPair *inPair, UInt32 inSrcIPAddr, UInt16 inSrcPort);
+
+  Shard fShards[kNumShards];
 };
 
 class UDPSocketPair {
  public:
 
   UDPSocketPair(UDPSocket *inSocketA, UDPSocket *inSocketB)
-      : fSocketA(inSocketA), fSocketB(inSocketB), fRefCount(0), fElem() {
+      : fSocketA(inSocketA), fSocketB(inSocketB), fRefCount(0), fElem(),
+        fPoolAddr(0), fSlot(-1) {
     fElem.SetEnclosingObject(this);
   }
   ~UDPSocketPair() = default;
@@ -107,6 +151,8 @@ class UDPSocketPair {
   UDPSocket *fSocketB;
   UInt32 fRefCount;
   QueueElem fElem;
+  UInt32 fPoolAddr;   // the local address the pool files this pair under
+  SInt32 fSlot;       // port slot, -1 if bound outside the slot range
 
   friend class UDPSocketPool;
 };
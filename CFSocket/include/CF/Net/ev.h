@@ -54,6 +54,10 @@ enum EREQ_EVENTS {
 #define EV_OS  EV_OS  /* one shot */
   EV_ET = 0x0020U,
 #define EV_ET  EV_ET  /* Edge Triggered */
+  EV_HU = 0x0040U,
+#define EV_HU  EV_HU  /* hang up or error, output only */
+  EV_ER = 0x0080U,
+#define EV_ER  EV_ER  /* error queue readable, output only */
 };
 #define EV_REOS  (EV_RE | EV_OS)
 #define EV_WROS  (EV_WR | EV_OS)
@@ -102,6 +106,20 @@ int select_watchevent(struct eventreq *req, int which);
 int select_modwatch(struct eventreq *req, int which);
 int select_waitevent(struct eventreq *req, void *onlyForMOSX);
 int select_removeevent(int which);
+/* number of events already fetched and not yet returned by select_waitevent,
+   0 means the next select_waitevent will wait on the OS */
+int select_pendingevents();
+/* spin on a non-blocking poll for up to inBusyPollUSec microseconds before
+   blocking in select_waitevent, 0 disables busy polling */
+void select_setbusypoll(UInt32 inBusyPollUSec);
+/* interrupt a blocking select_waitevent from any thread, it returns EINTR */
+void select_wakeup();
+
+#if __Linux__
+/* translation between EV_* bits and epoll flags, shared with EventPoller */
+UInt32 epoll_fromeventbits(int which);
+int epoll_toeventbits(UInt32 events);
+#endif
 
 #endif /* !MACOSXEVENTQUEUE */
 
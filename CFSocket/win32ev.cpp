@@ -113,6 +113,19 @@ int select_modwatch(struct eventreq *req, int which) {
   return ::WSAAsyncSelect(req->er_handle, sMsgWindow, theMsg, theEvent);
 }
 
+void select_setbusypoll(UInt32 /*inBusyPollUSec*/) {
+  // not supported by this implementation
+}
+
+void select_wakeup() {
+  if (sMsgWindow != NULL)
+    ::PostMessage(sMsgWindow, WM_TIMER, 0, 0);
+}
+
+int select_pendingevents() {
+  return 0; // every wait is accounted as a single event
+}
+
 int select_waitevent(struct eventreq *req, void * /*onlyForMacOSX*/) {
   if (sMsgWindow == NULL) {
     //
@@ -70,12 +70,23 @@ void IdleTaskThread::CancelTimeout(IdleTask *idleObj) {
   fIdleHeap.Remove(&idleObj->fIdleElem);
 }
 
+void IdleTaskThread::Stop() {
+  {
+    Core::MutexLocker locker(&fHeapMutex);
+    this->SendStopRequest();
+    fHeapCond.Signal();
+  }
+  this->StopAndWaitForThread();
+}
+
 void IdleTaskThread::Entry() {
   // 空闲任务线程启动后，该函数运行。主要由一个大循环构成:
 
   Core::MutexLocker locker(&fHeapMutex);
 
   while (true) {
+    if (IsStopRequested()) return;
+
     // if there are no events to process, block.
     while (fIdleHeap.CurrentHeapSize() == 0) {
       if (IsStopRequested()) return;
@@ -114,7 +114,7 @@ void Task::Signal(EventFlags events) {
                 "Task@%p::Signal: RTSP Thread running.\n",
                 this);
 
-      fUseThisThread->fTaskQueue.EnQueue(&fTaskQueueElem);
+      fUseThisThread->PostTask(this);
     } else {
       if (TaskThreadPool::sNumTaskThreads <= 0) {
         DEBUG_LOG(DEBUG_TASK,
@@ -163,7 +163,7 @@ void Task::Signal(EventFlags events) {
                 TaskThreadPool::sTaskThreadArray[theThreadIndex]->fTaskQueue.GetQueue()->GetLength(), &fTaskQueueElem);
 
       // 将任务压入 TaskThread 的就绪队列
-      TaskThreadPool::sTaskThreadArray[theThreadIndex]->fTaskQueue.EnQueue(&fTaskQueueElem);
+      TaskThreadPool::sTaskThreadArray[theThreadIndex]->PostTask(this);
 
       DEBUG_LOG(DEBUG_TASK,
                 "Task@%p::Signal: EnQueue A. Thread=%p fTaskQueue.GetLength(%" _U32BITARG_ ")\n",
@@ -387,6 +387,16 @@ void TaskThread::Entry() {
   }
 }
 
+void TaskThread::PostTask(Task *inTask) {
+  fTaskQueue.EnQueue(&inTask->fTaskQueueElem);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  // 线程阻塞在轮询器上时条件变量无法唤醒它。本线程投递的任务在 Poll 返回后
+  // 就会被取出，不需要唤醒
+  if (fPolling && Core::Thread::GetCurrent() != this)
+    fPoller->Wakeup();
+}
+
 Task *TaskThread::WaitForTask() {
   /* 该函数同样由一个大循环构成。等待任务的通知到达,或者因 stop 的请求而返回。 */
 
@@ -427,7 +437,24 @@ Task *TaskThread::WaitForTask() {
     /* TaskThread 类有一个 OSQueue_Blocking 类的私有成员 fTaskQueue。
      * 等待队列里有任务插入并将其取出返回。
      * 如果返回非空,则返回该队列项所对应的任务对象。 */
-    QueueElem *theElem = fTaskQueue.DeQueueBlocking(this, (SInt32) theTimeout);
+    QueueElem *theElem = nullptr;
+    if (fPoller != nullptr) {
+      /* thread-per-core: 在轮询器上等待 I/O，I/O 事件在本线程内分发，
+       * 被唤醒的 Task 直接进入本线程的队列。
+       * 先置 fPolling 再检查队列，与 PostTask 中先入队再检查 fPolling
+       * 相对应，保证投递不会丢失唤醒。 */
+      fPolling = true;
+      theElem = fTaskQueue.DeQueue();
+      if (theElem == nullptr) {
+        fPoller->Poll(theTimeout);
+        fPolling = false;
+        theElem = fTaskQueue.DeQueue();
+      } else {
+        fPolling = false;
+      }
+    } else {
+      theElem = fTaskQueue.DeQueueBlocking(this, (SInt32) theTimeout);
+    }
     if (theElem != nullptr) {
       DEBUG_LOG(DEBUG_TASK,
                 "TaskThread::WaitForTask found signal-task=%s Thread=%p "
@@ -449,7 +476,8 @@ UInt32       TaskThreadPool::sNumShortTaskThreads = 0;
 UInt32       TaskThreadPool::sNumBlockingTaskThreads = 0;
 
 bool TaskThreadPool::CreateThreads(UInt32 numShortTaskThreads,
-                                   UInt32 numBlockingThreads) {
+                                   UInt32 numBlockingThreads,
+                                   PollerFactory inPollerFactory) {
   /*
      根据 numToAdd 参数创建 TaskThread 类对象, 并调用该类的 Start 成员函数。
      将该类对象指针保存到 sTaskThreadArray 数组。
@@ -460,7 +488,12 @@ bool TaskThreadPool::CreateThreads(UInt32 numShortTaskThreads,
   sTaskThreadArray = new TaskThread *[numToAdd];
 
   for (UInt32 x = 0; x < numToAdd; x++) {
-    sTaskThreadArray[x] = new TaskThread();
+    // only short task threads run to completion, blocking threads keep
+    // waiting on their queue
+    TaskThreadPoller *thePoller = nullptr;
+    if (inPollerFactory != nullptr && x < numShortTaskThreads)
+      thePoller = inPollerFactory();
+    sTaskThreadArray[x] = new TaskThread(thePoller);
     sTaskThreadArray[x]->Start();
     DEBUG_LOG(DEBUG_TASK,
               "TaskThreadPool::AddThreads sTaskThreadArray[%" _U32BITARG_ "]=%p\n",
@@ -483,6 +516,15 @@ TaskThread *TaskThreadPool::GetThread(UInt32 index) {
   return sTaskThreadArray[index];
 }
 
+UInt32 TaskThreadPool::GetMaxQueueLength() {
+  UInt32 theMaxLength = 0;
+  for (UInt32 x = 0; x < sNumTaskThreads; x++) {
+    UInt32 theLength = sTaskThreadArray[x]->GetQueueLength();
+    if (theLength > theMaxLength) theMaxLength = theLength;
+  }
+  return theMaxLength;
+}
+
 void TaskThreadPool::RemoveThreads() {
   // Tell all the threads to stop
   for (UInt32 x = 0; x < sNumTaskThreads; x++)
@@ -490,8 +532,11 @@ void TaskThreadPool::RemoveThreads() {
 
   // Because any (or all) threads may be blocked on the Queue, cycle through
   // all the threads, signalling each one
-  for (UInt32 y = 0; y < sNumTaskThreads; y++)
-    sTaskThreadArray[y]->fTaskQueue.GetCond()->Signal();
+  for (UInt32 y = 0; y < sNumTaskThreads; y++) {
+    sTaskThreadArray[y]->fTaskQueue.Wakeup();
+    if (sTaskThreadArray[y]->fPoller != nullptr)
+      sTaskThreadArray[y]->fPoller->Wakeup();
+  }
 
   // Ok, now wait for the selected threads to terminate, deleting them and
   // removing them from the Queue.
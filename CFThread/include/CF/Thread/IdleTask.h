@@ -60,6 +60,9 @@ class IdleTaskThread : private Core::Thread {
   void SetIdleTimer(IdleTask *idleObj, SInt64 msec);
   void CancelTimeout(IdleTask *idleObj);
 
+  // stop without waiting for the pending timer or the 1s poll
+  void Stop();
+
   void Entry() override;
 
   Heap fIdleHeap; /* 时序-优先队列 */
@@ -81,7 +84,7 @@ class IdleTask : public Task {
 
   static void Release() {
     if (sIdleThread != nullptr) {
-      sIdleThread->StopAndWaitForThread();
+      sIdleThread->Stop();
       delete sIdleThread;
       sIdleThread = nullptr;
     }
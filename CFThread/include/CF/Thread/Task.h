@@ -60,6 +60,24 @@ namespace Thread {
 
 class TaskThread;
 
+/**
+ * @brief TaskThread 的 I/O 轮询器
+ *
+ * thread-per-core 模式下每个 TaskThread 拥有一个轮询器，空闲时在轮询器上
+ * 等待 I/O 事件(而不是条件变量)，事件就地分发给绑定在该线程的 Task，
+ * 不经过线程切换。其他线程 Signal 该线程的 Task 时，通过 Wakeup 唤醒。
+ */
+class TaskThreadPoller {
+ public:
+  virtual ~TaskThreadPoller() = default;
+
+  // wait at most inTimeoutMilli for I/O and dispatch what is ready
+  virtual void Poll(SInt64 inTimeoutMilli) = 0;
+
+  // interrupt a Poll in progress, may be called from any thread
+  virtual void Wakeup() = 0;
+};
+
 /**
  * Task 实例是可执行对象，是 CxxFramework 线程模型下的基本调度单元。
  * Task 具有事件驱动模型，可以被重复调度，但在同一时刻不会存在多个并发执行流。
@@ -197,11 +215,20 @@ class TaskThread : public Core::Thread {
 
   // Implementation detail: all tasks get run on TaskThreads.
 
-  TaskThread() : Thread(), fTaskThreadPoolElem() {
+  explicit TaskThread(TaskThreadPoller *inPoller = nullptr)
+      : Thread(), fTaskThreadPoolElem(), fPoller(inPoller), fPolling(false) {
     fTaskThreadPoolElem.SetEnclosingObject(this);
   }
 
-  ~TaskThread() override { this->StopAndWaitForThread(); }
+  ~TaskThread() override {
+    this->StopAndWaitForThread();
+    delete fPoller;
+  }
+
+  TaskThreadPoller *GetPoller() { return fPoller; }
+
+  // tasks signalled but not yet run, read without locking
+  UInt32 GetQueueLength() { return fTaskQueue.GetQueue()->GetLength(); }
 
  private:
 
@@ -213,8 +240,14 @@ class TaskThread : public Core::Thread {
 
   Task *WaitForTask();
 
+  // 将 Task 投递到本线程的任务队列(mailbox)，必要时唤醒轮询器
+  void PostTask(Task *inTask);
+
   QueueElem fTaskThreadPoolElem;
 
+  TaskThreadPoller *fPoller;   /* thread-per-core 模式下的 I/O 轮询器 */
+  std::atomic_bool fPolling;   /* 线程是否阻塞在 fPoller 上 */
+
   // use heap for time-sequence task, only in TaskThread, not concurrent.
   Heap fHeap;               /* 时序-优先队列 */
   BlockingQueue fTaskQueue; /* 事件-触发队列 */
@@ -233,13 +266,20 @@ class TaskThread : public Core::Thread {
 class TaskThreadPool {
  public:
 
+  typedef TaskThreadPoller *(*PollerFactory)();
+
   /**
    * @brief Adds some threads to the pool
    *
    * creates the threads: takes NumShortTaskThreads + NumBLockingThreads,
    * sets num short task threads.
+   *
+   * @param inPollerFactory - if not null, every short task thread gets its
+   *   own poller and runs in thread-per-core mode.
    */
-  static bool CreateThreads(UInt32 numShortTaskThreads, UInt32 numBlockingThreads);
+  static bool CreateThreads(UInt32 numShortTaskThreads,
+                            UInt32 numBlockingThreads,
+                            PollerFactory inPollerFactory = nullptr);
 
   static void RemoveThreads();
 
@@ -247,6 +287,11 @@ class TaskThreadPool {
 
   static UInt32 GetNumThreads() { return sNumTaskThreads; }
 
+  static UInt32 GetNumShortTaskThreads() { return sNumShortTaskThreads; }
+
+  // the longest task queue of all threads, used as a load indicator
+  static UInt32 GetMaxQueueLength();
+
  private:
   TaskThreadPool() = default;
 
@@ -47,6 +47,59 @@ class CFConfigure {
 
   virtual UInt32 GetShortTaskThreads() { return 1; }
   virtual UInt32 GetBlockingThreads() { return 1; }
+
+  //
+  // Event Model Settings
+
+  enum EventModel {
+    // 单个 EventThread 监听所有 Socket，事件通过 Task::Signal 投递到 TaskThread
+    kEventThreadModel = 0,
+    // 每个 short task thread 拥有自己的 epoll 实例和定时器，accept 之后连接
+    // 固定在一个线程上运行到完成，没有跨线程切换。此模式下 Session 运行在
+    // short task thread 上，CGI 不能阻塞。GetShortTaskThreads 返回 0 时每个
+    // 处理器一个线程
+    kThreadPerCoreModel = 1
+  };
+
+  virtual EventModel GetEventModel() { return kEventThreadModel; }
+
+  //
+  // EventThread Settings
+
+  // EventThread 阻塞前 busy-poll 的时长(微秒)，0 表示不 busy-poll。
+  // 开启后 EventThread 会占满一个核，用于延迟敏感的部署
+  virtual UInt32 GetEventBusyPollUSec() { return 0; }
+
+  // 设置到 Socket 的 SO_BUSY_POLL (微秒)，0 表示不设置
+  virtual UInt32 GetSocketBusyPollUSec() { return 0; }
+
+  //
+  // TCP Settings
+
+  // 监听 Socket 的 TCP_FASTOPEN 队列长度，0 表示不开启。
+  // 客户端带 cookie 的 SYN 可以直接携带请求，省去一次握手的 RTT
+  virtual UInt32 GetTCPFastOpenQueueLength() { return 0; }
+
+  // 监听 Socket 的 TCP_DEFER_ACCEPT (秒)，0 表示不开启。
+  // 连接收到数据后才唤醒 accept，超时后仍会交付
+  virtual UInt32 GetTCPDeferAcceptSec() { return 0; }
+
+  // TCPClientSocket 是否用 TCP Fast Open 发起连接
+  virtual bool GetTCPFastOpenConnect() { return false; }
+
+  // 监听 Socket 的 SO_RCVBUF (accept 得到的 Socket 继承)，0 表示系统默认
+  virtual UInt32 GetListenerRcvBufSize() { return 512 * 1024; }
+
+  // accept 得到的 Socket 的 SO_SNDBUF，0 表示系统默认
+  virtual UInt32 GetSessionSndBufSize() { return 96 * 1024; }
+
+  // 监听 Socket 的缓冲区策略，取值见 Net::TCPListenerSocket::BufferPolicy：
+  // 0 固定大小(上面两项)，1 交给内核自动调整，2 按 TCP_INFO 采样自适应
+  virtual UInt32 GetSocketBufferPolicy() { return 0; }
+
+  // 自适应策略下所有连接 SO_SNDBUF 的总预算(字节)，0 表示不限制。
+  // 超出预算时不再放大，空闲的连接回到最小值
+  virtual UInt64 GetSocketBufferBudget() { return 0; }
 };
 
 }
@@ -7,6 +7,7 @@
 
 #include <CF/CFDef.h>
 #include <CF/StrPtrLen.h>
+#include <CF/Core/Cond.h>
 
 namespace CF {
 
@@ -36,7 +37,14 @@ class CFEnv {
   static CFConfigure *GetConfigure() { return sConfigure; }
 
   static CF_Error WillExit() { return sExitCode; };
-  static void Exit(UInt32 exitCode) { sExitCode = exitCode; }
+  static void Exit(UInt32 exitCode);
+
+  /**
+   * @brief 等待退出请求，最多等待 inTimeoutMilli 毫秒
+   *
+   * @return 是否已请求退出
+   */
+  static bool WaitForExit(SInt32 inTimeoutMilli);
 
   static bool AddListenerSocket(Net::TCPListenerSocket *socket);
 
@@ -56,6 +64,8 @@ class CFEnv {
   static void makeServerHeader();
 
   static SInt32 sExitCode;
+  static Core::Mutex sExitMutex;
+  static Core::Cond sExitCond;
 
   static CFConfigure *sConfigure;
 
@@ -7,6 +7,7 @@
 
 #include <CF/Types.h>
 #include <CF/Queue.h>
+#include <CF/Core/Cond.h>
 #include <CF/Net/Socket/EventContext.h>
 
 namespace CF {
@@ -21,17 +22,35 @@ class CFState {
   };
   static std::atomic<UInt32> sState;
 
+  /**
+   * @brief 设置状态并等待 EventThread 处理完成
+   *
+   * EventThread 处理完后调用 NotifyProcessState 清除状态并唤醒等待者
+   */
   static void WaitProcessState(UInt32 state) {
+    Core::MutexLocker locker(&sStateMutex);
     sState |= state;
+#if !MACOSXEVENTQUEUE
+    ::select_wakeup(); // EventThread may be blocked in select_waitevent
+#endif
     while (sState & state) {
-      Core::Thread::Sleep(1000);
+      sStateCond.Wait(&sStateMutex, 1000);
     }
   }
 
+  static void NotifyProcessState(UInt32 state) {
+    Core::MutexLocker locker(&sStateMutex);
+    sState &= ~state;
+    sStateCond.Broadcast();
+  }
+
   static Queue sListenerSocket;
 
  private:
   CFState() = default;
+
+  static Core::Mutex sStateMutex;
+  static Core::Cond sStateCond;
 };
 
 }
@@ -2,6 +2,10 @@
 // Created by james on 8/27/17.
 //
 
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include <CF/CF.h>
 #include <CF/Net/Http/HTTPConfigure.hpp>
 
@@ -15,9 +19,14 @@ class MyConfig : public CFConfigure, public Net::HTTPConfigure {
 
   HTTPMapping *GetHttpMapping() override {
     static HTTPMapping defaultHttpMapping[] = {
-        {"/exit", (CF_CGIFunction) DefaultExitCGI},
-        {"/", (CF_CGIFunction) DefaultCGI},
-        {NULL, NULL}
+        {"/exit", (CF_CGIFunction) DefaultExitCGI, nullptr, nullptr},
+        {"/upload", (CF_CGIFunction) UploadCGI, (CF_CGIBodyFunction) UploadBody, nullptr},
+        {"/stream", (CF_CGIFunction) StreamCGI, nullptr, nullptr},
+        {"/ticks", (CF_CGIFunction) TicksCGI, nullptr, nullptr},
+        {"/delay", nullptr, nullptr, (CF_CGIAsyncFunction) DelayCGI},
+        {"/users/{id}", (CF_CGIFunction) UserCGI, nullptr, nullptr},
+        {"/", (CF_CGIFunction) DefaultCGI, nullptr, nullptr},
+        {NULL, NULL, NULL, NULL}
     };
     return defaultHttpMapping;
   }
@@ -32,8 +41,169 @@ class MyConfig : public CFConfigure, public Net::HTTPConfigure {
     response.SetBody(content);
     return CF_NoErr;
   }
+
+  static CF_Error StreamCGI(CF::Net::HTTPPacket &request,
+                            CF::Net::HTTPPacket &response);
+
+  // ?n= lines, one every ?ms= milliseconds from another thread
+  static CF_Error TicksCGI(CF::Net::HTTPPacket &request,
+                           CF::Net::HTTPPacket &response);
+
+  static CF_Error UserCGI(CF::Net::HTTPPacket &request,
+                          CF::Net::HTTPPacket &response) {
+    StrPtrLen *theId = request.GetPathParam("id");
+    ResizeableStringFormatter formatter(nullptr, 0);
+    formatter.Put("user ");
+    formatter.Put(*theId);
+    formatter.Put("\n");
+    StrPtrLen *content = new StrPtrLen(formatter.GetAsCString(),
+                                       formatter.GetCurrentOffset());
+    response.SetBody(content);
+    return CF_NoErr;
+  }
+
+  // answers after ?ms= milliseconds from another thread, 504 after 1s
+  static CF_Error DelayCGI(CF::Net::HTTPPacket &request,
+                           CF::Net::HTTPPacket &response,
+                           CF::Net::HTTPCompletion *completion);
+
+  // the body is streamed here piece by piece, it is never held in memory;
+  // the byte count of each upload is kept in its request
+  static void ReleaseUploadSize(void *context) {
+    delete (UInt64 *) context;
+  }
+
+  static CF_Error UploadBody(CF::Net::HTTPPacket &request,
+                             StrPtrLen &data, bool /*last*/, bool aborted) {
+    if (aborted)
+      return CF_NoErr; // the request goes away with its count
+
+    auto *size = (UInt64 *) request.GetContext();
+    if (size == nullptr) {
+      size = new UInt64(0);
+      request.SetContext(size, ReleaseUploadSize);
+    }
+    *size += data.Len;
+    return CF_NoErr;
+  }
+
+  static CF_Error UploadCGI(CF::Net::HTTPPacket &request,
+                            CF::Net::HTTPPacket &response) {
+    auto *size = (UInt64 *) request.GetContext();
+    char message[64];
+    s_snprintf(message, sizeof(message), "received %llu bytes\n",
+               (unsigned long long) (size != nullptr ? *size : 0));
+    ResizeableStringFormatter formatter(nullptr, 0);
+    formatter.Put(message);
+    StrPtrLen *content = new StrPtrLen(formatter.GetAsCString(),
+                                       formatter.GetCurrentOffset());
+    response.SetBody(content);
+    return CF_NoErr;
+  }
+};
+
+// the lines are generated as the client takes them, never the whole body
+class LineStream : public Net::HTTPBodyStream {
+ public:
+  explicit LineStream(UInt32 inLines) : fLine(0), fLines(inLines) {}
+
+  CF_Error Read(char *ioBuffer, UInt32 inLength, UInt32 *outLength) override {
+    UInt32 theLen = 0;
+    while (fLine < fLines && inLength - theLen >= 32) {
+      theLen += s_snprintf(ioBuffer + theLen, inLength - theLen,
+                           "line %" _U32BITARG_ "\n", fLine++);
+    }
+    *outLength = theLen;
+    return theLen > 0 ? CF_NoErr : CF_NoMoreData;
+  }
+
+ private:
+  UInt32 fLine;
+  UInt32 fLines;
 };
 
+CF_Error MyConfig::StreamCGI(CF::Net::HTTPPacket &request,
+                             CF::Net::HTTPPacket &response) {
+  response.SetBodyStream(new LineStream(100000));
+  return CF_NoErr;
+}
+
+// the lines come from a producer thread, the session is woken for each
+class TickStream : public Net::HTTPBodyStream {
+ public:
+  TickStream(UInt32 inTicks, UInt32 inInterval)
+      : fTicks(inTicks), fReady(0), fSent(0), fStop(false) {
+    fProducer = std::thread([this, inInterval]() {
+      std::unique_lock<std::mutex> locker(fMutex);
+      while (fReady < fTicks) {
+        if (fCond.wait_for(locker, std::chrono::milliseconds(inInterval),
+                           [this]() { return fStop; }))
+          return;
+        fReady++;
+        this->Wakeup();
+      }
+    });
+  }
+
+  ~TickStream() override {
+    {
+      std::lock_guard<std::mutex> locker(fMutex);
+      fStop = true;
+    }
+    fCond.notify_one();
+    fProducer.join();
+  }
+
+  CF_Error Read(char *ioBuffer, UInt32 inLength, UInt32 *outLength) override {
+    std::lock_guard<std::mutex> locker(fMutex);
+    if (fSent == fTicks)
+      return CF_NoMoreData;
+    if (fSent == fReady)
+      return CF_WouldBlock;
+
+    *outLength = (UInt32) s_snprintf(ioBuffer, inLength, "tick %" _U32BITARG_ "\n", fSent++);
+    return CF_NoErr;
+  }
+
+ private:
+  UInt32 fTicks;
+  UInt32 fReady;
+  UInt32 fSent;
+  bool fStop;
+  std::mutex fMutex;
+  std::condition_variable fCond;
+  std::thread fProducer;
+};
+
+CF_Error MyConfig::TicksCGI(CF::Net::HTTPPacket &request,
+                            CF::Net::HTTPPacket &response) {
+  char const *theTicks = request.GetQueryValues((char *) "n");
+  char const *theInterval = request.GetQueryValues((char *) "ms");
+  response.SetBodyStream(new TickStream(
+      theTicks != nullptr ? (UInt32) ::atoi(theTicks) : 10,
+      theInterval != nullptr ? (UInt32) ::atoi(theInterval) : 100));
+  return CF_NoErr;
+}
+
+CF_Error MyConfig::DelayCGI(CF::Net::HTTPPacket &request,
+                            CF::Net::HTTPPacket &response,
+                            CF::Net::HTTPCompletion *completion) {
+  char const *theValue = request.GetQueryValues((char *) "ms");
+  UInt32 theDelay = theValue != nullptr ? (UInt32) ::atoi(theValue) : 100;
+
+  completion->SetTimeout(1000);
+  std::thread([&response, completion, theDelay]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(theDelay));
+    ResizeableStringFormatter formatter(nullptr, 0);
+    formatter.Put("delayed content\n");
+    response.SetBody(new StrPtrLen(formatter.GetAsCString(),
+                                   formatter.GetCurrentOffset()));
+    completion->Complete();
+  }).detach();
+
+  return CF_WouldBlock;
+}
+
 CF_Error CFInit(int argc, char **argv) {
   CFConfigure *config = new MyConfig();
   CFEnv::Register(config);